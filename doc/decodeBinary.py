@@ -0,0 +1,110 @@
+#! /usr/bin/env python3
+
+# Decode the compressed data.bin written by ALog::set_binary_output() into
+# comma-separated text: the time stamp, then each value with the decimal
+# places that the data file would have given it. Text values (from
+# record()) are not in data.bin, so their columns are left out; the other
+# column labels are in header.txt. A damaged block is reported and skipped,
+# and decoding resumes at the next block that reads cleanly.
+#
+# Usage: python3 decodeBinary.py <data.bin> [output.txt]
+# e.g.:  python3 decodeBinary.py /media/SD/data.bin > data.txt
+
+import sys
+
+
+class Truncated(Exception):
+    pass
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise Truncated()
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value & 0xFFFFFFFF, pos
+        shift += 7
+        if shift > 28:
+            raise ValueError('varint too long')
+
+
+def read_zigzag(data, pos):
+    value, pos = read_varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def to_int32(value):
+    value &= 0xFFFFFFFF
+    return value - (1 << 32) if value >= (1 << 31) else value
+
+
+def format_value(quantized, decimals):
+    # As Print::print(value, decimals): e.g., -9999 with 2 decimals is
+    # -9999.00
+    if decimals == 0:
+        return str(quantized)
+    sign = '-' if quantized < 0 else ''
+    digits = str(abs(quantized)).rjust(decimals + 1, '0')
+    return sign + digits[:-decimals] + '.' + digits[-decimals:]
+
+
+def decode(data, out):
+    pos = 0
+    values = None
+    while pos < len(data):
+        start = pos
+        try:
+            header, pos = read_varint(data, pos)
+            if header == 1:
+                if pos >= len(data):
+                    raise Truncated()
+                n = data[pos]
+                decimals = list(data[pos + 1:pos + 1 + n])
+                if len(decimals) < n:
+                    raise Truncated()
+                pos += 1 + n
+                unixtime, pos = read_varint(data, pos)
+                line = []
+                for i in range(n):
+                    value, pos = read_zigzag(data, pos)
+                    line.append(to_int32(value))
+            elif header & 1 or values is None:
+                raise ValueError('not a line or block start')
+            else:
+                unixtime += header >> 1
+                line = []
+                for i in range(len(values)):
+                    delta, pos = read_zigzag(data, pos)
+                    line.append(to_int32(values[i] + delta))
+        except Truncated:
+            sys.stderr.write('Incomplete last line at byte %d\n' % start)
+            return
+        except ValueError as error:
+            sys.stderr.write('Damaged data at byte %d (%s): skipping to the '
+                             'next block\n' % (start, error))
+            values = None
+            pos = start + 1
+            while pos < len(data) and data[pos] != 1:
+                pos += 1
+            continue
+        values = line
+        out.write(','.join([str(unixtime)] +
+                           [format_value(v, d)
+                            for v, d in zip(values, decimals)]) + '\n')
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        sys.exit('Usage: python3 decodeBinary.py <data.bin> [output.txt]')
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as out:
+            decode(data, out)
+    else:
+        decode(data, sys.stdout)
@@ -0,0 +1,27 @@
+#! /bin/sh
+
+# Per-function stack frame sizes for the ALog library, from an AVR build
+# of a sketch. Functions with large frames (and those that call them) are
+# the ones to look at if get_min_free_ram() / header.txt shows little
+# free RAM.
+#
+# Requires arduino-cli, with the board package installed.
+# Usage: sh stackUsage.sh <sketch folder> <FQBN> [number of functions]
+# e.g.:  sh stackUsage.sh ../examples/BasicStart arduino:avr:uno 30
+
+SKETCH=$1
+FQBN=$2
+NFUNCTIONS=${3:-40}
+BUILD=$(mktemp -d)
+
+arduino-cli compile --fqbn "$FQBN" --build-path "$BUILD" \
+  --build-property "compiler.cpp.extra_flags=-fstack-usage" "$SKETCH" \
+  > /dev/null || exit 1
+
+# .su lines: file:line:column:function<TAB>bytes<TAB>static|dynamic
+echo "bytes	type	function"
+find "$BUILD" -name "*.su" -exec cat {} + | \
+  awk -F'\t' '{sub(/^[^:]*:[^:]*:[^:]*:/, "", $1); print $2 "\t" $3 "\t" $1}' | \
+  sort -n -r | head -n "$NFUNCTIONS"
+
+rm -rf "$BUILD"
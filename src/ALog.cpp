@@ -64,117 +64,243 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /////////////////
 
 
-// True for all: UNO (ATMega168/328)
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__)
+// Each supported board has a profile, selected at compile time, that holds
+// its pins, the polarity of its power switches, its ADC reference, and its
+// I2C clock speed. Because these are constexpr, the compiler folds them into
+// the code that uses them: no run-time lookups or branches by board.
+// -1 means that the board does not have this pin.
+struct ALogBoardProfile {
+  bool supported; // False if the ALog library does not know this board
   // SD card: CSpin and protected pins
-  const int8_t SCKpin = 13;
-  const int8_t MISOpin = 12;
-  const int8_t MOSIpin = 11;
-  const int8_t CSpin = 10;
+  int8_t SCKpin;
+  int8_t MISOpin;
+  int8_t MOSIpin;
+  int8_t CSpin;
   // Protected I2C pins
-  const int8_t SDApin = A4;
-  const int8_t SCLpin = A5;
+  int8_t SDApin;
+  int8_t SCLpin;
   // Sleep mode pins
-  const int8_t wakePin = 2; // interrupt pin used for waking up via the alarm
-  const int8_t manualWakePin = 5; // Wakes the logger with a manual button - overrides the "wait for right minute" commands
-  #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V2)
-    // SD and RTC power switch
-    // 7 for both? Maybe this is better than redefining variables.
-    // GitHub issue is open on this; should guide future decisions
-    int8_t SDpowerPin = 7; // Turns on voltage source to SD card
-    int8_t RTCpowerPin = 7; // Activates voltage regulator to power the RTC (otherwise is on backup power from VCC or batt)
-    // LED power switch
-    int8_t LEDpin = 8; // LED to tell user if logger is working properly
-    // External device power switch
-    int8_t SensorPowerPin = 4; // Activates voltage regulator to give power to sensors
-    int8_t EXT_3V3 = -1; // Activates voltage regulator to give power to sensors
-    int8_t EXT_5V0 = -1; // Activates voltage regulator to give power to sensors
-    // Voltage reference power
-    int8_t REF_1V8 = -1; // Activates precision voltage reference
-  #elif defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_PRE_V200)
-    // SD and RTC power switch
-    int8_t SDpowerPin = 8; // Turns on voltage source to SD card
-    int8_t RTCpowerPin = 6; // Activates voltage regulator to power the RTC (otherwise is on backup power from VCC or batt)
-    // LED power switch
-    int8_t LEDpin = 9; // LED to tell user if logger is working properly
-    // External device power switch
-    int8_t SensorPowerPin = 4; // Activates voltage regulator to give power to sensors
-  #else
-    // These can be variable; default values here are for the ALog shield
-    // No pin is appropriate for the ALog shield for SDpowerPin and RTCpowerPin,
-    // as these are controlled by the internal 3V3 regulator
-    int8_t LEDpin = 8;
-    int8_t SDpowerPin = -1;
-    int8_t RTCpowerPin = -1;
-    // External device power switch
-    int8_t SensorPowerPin = -1; // Activates voltage regulator to give power to sensors
-    int8_t EXT_3V3 = -1; // Activates voltage regulator to give power to sensors
-    int8_t EXT_5V0 = -1; // Activates voltage regulator to give power to sensors
-    // Voltage reference power
-    int8_t REF_1V8 = -1; // Activates precision voltage reference
-  #endif
+  int8_t wakePin; // interrupt pin used for waking up via the alarm
+  int8_t manualWakePin; // LOG NOW button
+  // SD and RTC power switches
+  int8_t SDpowerPin;
+  int8_t RTCpowerPin;
+  // LED power switch
+  int8_t LEDpin;
+  // External device power switches and voltage reference power
+  int8_t SensorPowerPin;
+  int8_t EXT_3V3;
+  int8_t EXT_5V0;
+  int8_t REF_1V8;
+  // Battery voltage, through a 10:1 divider
+  int8_t VbattPin;
+  // Polarity
+  bool SDpower_active_low; // SD card is powered when SDpowerPin is LOW
+  bool EXT_3V3_active_low; // 3V3 sensor rail is on when EXT_3V3 is LOW
+  // Analog and I2C
+  uint8_t analog_reference;
+  uint32_t I2C_clock_Hz;
+};
+
+#if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_PRE_V200)
+  const char BOARD_NAME[] PROGMEM = "ALog BottleLogger pre-v2.0.0";
+  constexpr ALogBoardProfile BOARD = {true,
+    13, 12, 11, 10,       // SCK, MISO, MOSI, CS
+    A4, A5,               // SDA, SCL
+    2, 5,                 // wake, LOG NOW
+    8, 6, 9,              // SD power, RTC power, LED
+    4, -1, -1, -1,        // Sensor power, EXT_3V3, EXT_5V0, REF_1V8
+    -1,                   // Battery voltage
+    false, false,         // Active-low SD power, EXT_3V3
+    EXTERNAL, 100000};    // Analog reference, I2C clock
+#elif defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V2)
+  // GitHub issue is open on SD and RTC power sharing pin 7; should guide
+  // future decisions
+  const char BOARD_NAME[] PROGMEM = "ALog BottleLogger v2.X.Y";
+  constexpr ALogBoardProfile BOARD = {true,
+    13, 12, 11, 10,
+    A4, A5,
+    2, 5,
+    7, 7, 8,
+    4, -1, -1, -1,
+    -1,
+    false, false,
+    EXTERNAL, 100000};
+#elif defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3)
+  // Prototype was EXT_3V3 = 22, EXT_5V0 = 20; new board EXT_3V3 = A2,
+  // EXT_5V0 = A3. RTC power was D1 on the prototype; new board does not shut
+  // down.
+  const char BOARD_NAME[] PROGMEM = "ALog BottleLogger v3.X.Y";
+  constexpr ALogBoardProfile BOARD = {true,
+    7, 6, 5, 21,
+    17, 16,
+    2, 23,
+    18, 1, 0,
+    -1, 26, 27, 19,
+    A7,
+    true, true,
+    EXTERNAL, 100000};
+#elif defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) \
+      || defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__)
+  // These can be variable; default values here are for the ALog shield
+  // No pin is appropriate for the ALog shield for SDpowerPin and RTCpowerPin,
+  // as these are controlled by the internal 3V3 regulator
+  const char BOARD_NAME[] PROGMEM = \
+      "ATMega168/328 Arduino (e.g., Uno with or without ALog shield)";
+  constexpr ALogBoardProfile BOARD = {true,
+    13, 12, 11, 10,
+    A4, A5,
+    2, 5,
+    -1, -1, 8,
+    -1, -1, -1, -1,
+    -1,
+    false, false,
+    EXTERNAL, 100000};
+#elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644__) \
+      || defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284p__)
+  const char BOARD_NAME[] PROGMEM = "ATMega644 or ATMega1284";
+  constexpr ALogBoardProfile BOARD = {true,
+    -1, -1, -1, -1,
+    -1, -1,
+    -1, -1,
+    -1, -1, -1,
+    -1, -1, -1, -1,
+    -1,
+    true, true,
+    EXTERNAL, 100000};
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  const char BOARD_NAME[] PROGMEM = "ATMega1280/2560 Arduino Mega";
+  constexpr ALogBoardProfile BOARD = {true,
+    52, 50, 51, 53,
+    20, 21,
+    2, -1,
+    -1, -1, -1,
+    -1, -1, -1, -1,
+    -1,
+    false, false,
+    EXTERNAL, 100000};
+#else
+  const char BOARD_NAME[] PROGMEM = "Unknown";
+  constexpr ALogBoardProfile BOARD = {false,
+    -1, -1, -1, -1,
+    -1, -1,
+    -1, -1,
+    -1, -1, -1,
+    -1, -1, -1, -1,
+    -1,
+    false, false,
+    EXTERNAL, 100000};
 #endif
-// True for all: MEGA (ATMega1280/2560)
-#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-  // SD card: CSpin and protected pins
-  const int8_t SCKpin = 52;
-  const int8_t MISOpin = 50;
-  const int8_t MOSIpin = 51;
-  const int8_t CSpin = 53;
-  // Protected I2C pins
-  const int8_t SDApin = 20;
-  const int8_t SCLpin = 21;
-  // Sleep mode pins: same as for 328
-  const int8_t wakePin = 2; // interrupt pin used for waking up via the alarm
+
+// ADC multiplexer setting that reads the internal 1.1 V bandgap reference
+#if defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644__) \
+      || defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284p__) \
+      || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  #define BANDGAP_ADMUX 0x1E
+#else
+  #define BANDGAP_ADMUX 0x0E
 #endif
 
-#if defined(__AVR_ATmega644P__) || defined(__AVR_ATmega1284p__) || (__AVR_ATmega644__)
-  #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3)
-    // SD card: CSpin and protected pins
-    const int8_t SCKpin = 7;
-    const int8_t MISOpin = 6;
-    const int8_t MOSIpin = 5;
-    const int8_t CSpin = 21;
-    // Protected I2C pins
-    const int8_t SDApin = 17;
-    const int8_t SCLpin = 16;
-    // Sleep mode pins
-    const int8_t wakePin = 2; // interrupt pin used for waking up via the alarm
-    const int8_t manualWakePin = 23; // Wakes the logger with a manual button - overrides the "wait for right minute" commands
-    int8_t SDpowerPin = 18; // Turns on voltage source to SD card
-    int8_t RTCpowerPin = 1; // Activates voltage regulator to power the RTC (otherwise is on backup power from VCC or batt), prototype was D1, new board does not shut down.
-    // LED power switch
-    int8_t LEDpin = 0; // LED to tell user if logger is working properly
-    // External device power switch
-    int8_t SensorPowerPin = -1; //Not used for V3
-    int8_t EXT_3V3 = 26; // Activates voltage regulator to give power to sensors, prototype was  int8_t EXT_3V3 = 22, new board   int8_t EXT_3V3 = A2;
-    int8_t EXT_5V0 = 27; // Activates voltage regulator to give power to sensors, prototype was  int8_t EXT_5V0 = 20, new board   int8_t EXT_5V0 = A3;
-    // Voltage reference power
-    int8_t REF_1V8 = 19; // Activates precision voltage reference
-  #else
-    const int8_t SCKpin = -1;
-    const int8_t MISOpin = -1;
-    const int8_t MOSIpin = -1;
-    const int8_t CSpin = -1;
-    // Protected I2C pins
-    const int8_t SDApin = -1;
-    const int8_t SCLpin = -1;
-    // Sleep mode pins
-    const int8_t wakePin = -1; // interrupt pin used for waking up via the alarm
-    const int8_t manualWakePin = -1; // Wakes the logger with a manual button - overrides the "wait for right minute" commands
-    int8_t SDpowerPin = -1; // Turns on voltage source to SD card
-    int8_t RTCpowerPin = -1; // Activates voltage regulator to power the RTC (otherwise is on backup power from VCC or batt), prototype was D1, new board does not shut down.
-    // LED power switch
-    int8_t LEDpin = -1; // LED to tell user if logger is working properly
-    // External device power switch
-    int8_t SensorPowerPin = -1; //Not used for V3
-    int8_t EXT_3V3 = -1; // Activates voltage regulator to give power to sensors, prototype was  int8_t EXT_3V3 = 22, new board   int8_t EXT_3V3 = A2;
-    int8_t EXT_5V0 = -1; // Activates voltage regulator to give power to sensors, prototype was  int8_t EXT_5V0 = 20, new board   int8_t EXT_5V0 = A3;
-    // Voltage reference power
-    int8_t REF_1V8 = -1; // Activates precision voltage reference
+// Pins that are fixed by the board
+const int8_t SCKpin = BOARD.SCKpin;
+const int8_t MISOpin = BOARD.MISOpin;
+const int8_t MOSIpin = BOARD.MOSIpin;
+const int8_t CSpin = BOARD.CSpin;
+const int8_t SDApin = BOARD.SDApin;
+const int8_t SCLpin = BOARD.SCLpin;
+const int8_t wakePin = BOARD.wakePin;
+const int8_t manualWakePin = BOARD.manualWakePin;
+
+// Pins that may be changed by the set_...() functions (e.g., for an Arduino
+// with the ALog shield or a custom board). Each has a bit in _custom_pins
+// that the setter sets; until it does, ALOG_PIN() gives the board's pin as a
+// compile-time constant, so changing one pin leaves the others fast.
+int8_t SDpowerPin = BOARD.SDpowerPin; // Turns on voltage source to SD card
+int8_t RTCpowerPin = BOARD.RTCpowerPin; // Activates voltage regulator to power the RTC (otherwise is on backup power from VCC or batt)
+int8_t LEDpin = BOARD.LEDpin; // LED to tell user if logger is working properly
+int8_t SensorPowerPin = BOARD.SensorPowerPin; // Activates voltage regulator to give power to sensors
+int8_t EXT_3V3 = BOARD.EXT_3V3; // Activates voltage regulator to give power to sensors
+int8_t EXT_5V0 = BOARD.EXT_5V0; // Activates voltage regulator to give power to sensors
+int8_t REF_1V8 = BOARD.REF_1V8; // Activates precision voltage reference
+#define CUSTOM_SDpowerPin 0x01
+#define CUSTOM_RTCpowerPin 0x02
+#define CUSTOM_LEDpin 0x04
+#define CUSTOM_SensorPowerPin 0x08
+#define CUSTOM_EXT_3V3 0x10
+#define CUSTOM_EXT_5V0 0x20
+#define CUSTOM_REF_1V8 0x40
+uint8_t _custom_pins = 0;
+uint32_t _i2c_clock_Hz = BOARD.I2C_clock_Hz; // See set_I2C_clock()
+// Build with ALOG_FIXED_PINS defined (e.g., -DALOG_FIXED_PINS in the
+// board's build flags) to use the board's pins only: the set_...() pin
+// changes then have no effect, and no pin is looked up at run time.
+#if defined(ALOG_FIXED_PINS)
+  #define ALOG_PIN_IS_CUSTOM(name) false
+#else
+  #define ALOG_PIN_IS_CUSTOM(name) (_custom_pins & CUSTOM_##name)
+#endif
+#define ALOG_PIN(name) (ALOG_PIN_IS_CUSTOM(name) ? name : BOARD.name)
+
+// Fast GPIO for the fixed-function pins (power switches, LED). When the pin
+// is known at compile time, as it is from the board profile, the write
+// compiles to a single sbi/cbi instruction on its port. Otherwise (custom
+// pins, or a board without a port map here), it is a digitalWrite().
+__attribute__((always_inline)) static inline volatile uint8_t* \
+    fast_pin_port(int8_t pin){
+  #if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) \
+      || defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__)
+    if (pin < 8) return &PORTD;
+    if (pin < 14) return &PORTB;
+    if (pin < 20) return &PORTC;
+  #elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega644__) \
+        || defined(__AVR_ATmega1284P__) || defined(__AVR_ATmega1284p__)
+    // MightyCore standard pinout
+    if (pin < 8) return &PORTB;
+    if (pin < 16) return &PORTD;
+    if (pin < 24) return &PORTC;
+    if (pin < 32) return &PORTA;
   #endif
+  return NULL;
+}
 
-#endif
+__attribute__((always_inline)) static inline uint8_t fast_pin_mask(int8_t pin){
+  #if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) \
+      || defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__)
+    if (pin >= 14) return _BV(pin - 14);
+    if (pin >= 8) return _BV(pin - 8);
+  #endif
+  return _BV(pin & 7);
+}
+
+__attribute__((always_inline)) static inline void fast_digital_write( \
+    int8_t pin, uint8_t level){
+  if (__builtin_constant_p(pin) && (pin < 0 || fast_pin_port(pin) != NULL)){
+    if (pin < 0){
+      return; // Not on this board
+    }
+    if (level){
+      *fast_pin_port(pin) |= fast_pin_mask(pin);
+    }
+    else {
+      *fast_pin_port(pin) &= ~fast_pin_mask(pin);
+    }
+  }
+  else if (pin >= 0){
+    digitalWrite(pin, level);
+  }
+}
+
+// Write to a fixed-function pin: the board profile's pin (fast) unless
+// this pin has been customized with its set_...() function
+#define ALOG_PIN_WRITE(name, level) \
+  do { \
+    if (ALOG_PIN_IS_CUSTOM(name)){ \
+      if (name >= 0) digitalWrite(name, level); \
+    } \
+    else { \
+      fast_digital_write(BOARD.name, level); \
+    } \
+  } while (0)
 
 /*
 #elif(_model == big_log)
@@ -218,7 +344,8 @@ bool CAMERA_IS_ON = false; // for a video camera
 // IS_LOGGING tells the logger if it is awake and actively logging
 // Prevents being put back to sleep by an event (e.g., rain gage bucket tip)
 // if it is in the middle of logging, so it will return to logging instead.
-bool IS_LOGGING = false;
+// Volatile: set by the wake-up interrupts and read by the sleep loop
+volatile bool IS_LOGGING = false;
 
 // Filename and logger name
 // Filename is set up as 8.3 filename:
@@ -228,7 +355,7 @@ char* logger_name;
 
 // For interrupt from sensor
 bool extInt; // This will default to Pin 3 (INT(errupt) 1 on ALog BottleLogger)
-bool NEW_RAIN_BUCKET_TIP = false; // flag
+volatile bool NEW_RAIN_BUCKET_TIP = false; // flag, set by wakeUpNow_tip()
 bool LOG_ALL_SENSORS_ON_BUCKET_TIP; // Defaults to False, true if you should
                                     // all sensors every time an event (e.g.,
                                     // rain gage bucket tip) happens
@@ -241,8 +368,128 @@ bool LOG_ALL_SENSORS_ON_BUCKET_TIP; // Defaults to False, true if you should
 bool first_log_after_booting_up = true;
 
 // Rotation count for anemometer
-// Unlikely to go over 255...???
-uint8_t rotation_count = 0;
+// 16 bits: an 8-bit counter overflowed after 255 rotations (~6 s at 40 Hz)
+volatile uint16_t rotation_count = 0;
+// Time of the last counted rotation, for debouncing inside of the ISR
+volatile unsigned long _anemometer_last_rotation_micros = 0;
+
+// Background accumulators: count anemometer rotations and rain gauge bucket
+// tips across the whole sleep interval. Pins are -1 when not in use.
+int8_t _wind_accumulator_pin = -1;
+int8_t _rain_accumulator_pin = -1;
+float _accumulator_meters_per_second_per_rotation;
+float _accumulator_mm_per_tip;
+volatile uint32_t _wind_accumulated_rotations = 0;
+volatile uint16_t _rain_accumulated_tips = 0;
+// False while a level-triggered (sleeping) interrupt waits for its switch
+// to re-open
+volatile bool _wind_accumulator_armed = false;
+volatile bool _rain_accumulator_armed = false;
+volatile unsigned long _wind_accumulator_last_micros = 0;
+volatile unsigned long _rain_accumulator_last_micros = 0;
+// The watchdog ticks every ~1 s while asleep, or every ~16 ms while a
+// switch waits to be re-armed; time is kept in 16 ms units
+volatile bool _accumulators_fast_tick = false;
+volatile uint8_t _accumulator_tick_units = 0;
+// Peak wind: most rotations counted within one ~1 s of watchdog ticks
+volatile uint32_t _wind_rotations_at_tick = 0;
+volatile uint16_t _wind_max_rotations_per_tick = 0;
+// Peak rain: most bucket tips counted within one ~1 min of watchdog ticks
+volatile uint8_t _rain_tick_seconds = 0;
+volatile uint16_t _rain_tips_at_minute = 0;
+volatile uint16_t _rain_max_tips_per_minute = 0;
+// Start of the interval over which the accumulators are reported
+uint32_t _accumulation_start_unixtime;
+
+// BMP180 barometer: one instance, so that its calibration coefficients are
+// read only once, and the state of any measurement in progress
+SFE_BMP180 _bmp180;
+bool _bmp180_calibrated = false;
+uint8_t _bmp180_state = BMP180_IDLE;
+unsigned long _bmp180_ready_millis;
+double _bmp180_T;
+double _bmp180_P;
+const __FlashStringHelper* _bmp180_error = NULL;
+
+// Event trigger (see set_trigger()): thresholds, rate limit, and burst
+// interval; whether the logger is bursting, and whether it should go back
+// to the normal schedule at the end of this logging event; the last value
+// and its time, for the rate of change
+bool _trigger_enabled = false;
+float _trigger_on;
+float _trigger_off;
+float _trigger_rate_limit;
+uint16_t _trigger_burst_interval_seconds;
+bool _trigger_active = false;
+bool _trigger_released = false;
+bool _trigger_have_last_value = false;
+float _trigger_last_value;
+uint32_t _trigger_last_unixtime;
+
+// Supply voltage watch (see set_battery_thresholds()): thresholds and the
+// logging interval multiplier below the critical one; the voltage measured
+// this logging event, and the state that it puts the logger in; and
+// whether it should go back to the normal schedule at the end of this
+// logging event
+bool _battery_watch = false;
+float _battery_low_volts;
+float _battery_critical_volts;
+uint8_t _battery_interval_multiplier;
+float _supply_voltage = -9999;
+uint8_t _battery_state = ALOG_BATTERY_OK;
+bool _battery_recovered = false;
+bool _battery_thresholds_refused = false; // Above the supply: see setter
+
+// Windowed aggregation (see set_aggregation())
+ALogAggregation _aggregation;
+bool _aggregate_keep_raw = false;
+
+// The line of data being recorded
+ALogLineBuffer _line;
+
+// Compressed binary data stream (see set_binary_output()), allocated only
+// if it is used
+ALogBinaryEncoder *_binary = NULL;
+
+// LTC2495 external ADC: I2C address, and the code read from the 1.8 V
+// reference channel this logging event (0 until measured)
+uint8_t _ltc2495_address = LTC2495_ADDRESS;
+int32_t _ltc2495_reference_code = 0;
+
+// Stack painting: before main() runs, all RAM between the end of the global
+// variables and the top of the stack is filled with STACK_PAINT_BYTE. The
+// stack overwrites this as it grows, so the paint that is left shows how
+// close the stack has come to the globals and heap since boot.
+#define STACK_PAINT_BYTE 0xC5
+extern uint8_t _end; // Linker: end of global variables (start of heap)
+extern uint8_t __stack; // Linker: top of RAM (start of stack)
+extern char *__brkval; // avr-libc: top of the heap (0 until malloc is used)
+
+void _paint_stack() __attribute__((naked, used, section(".init3")));
+void _paint_stack(){
+  // Runs as part of the startup code: no call, no return, stack still empty
+  uint8_t *p = &_end;
+  while (p <= &__stack){
+    *p = STACK_PAINT_BYTE;
+    p++;
+  }
+}
+
+// Sensor power rails (see rail_on()): number of sensors using each, and when
+// each was switched on, for warm-up times
+uint8_t _rail_users[N_RAILS] = {0, 0, 0};
+unsigned long _rail_on_millis[N_RAILS];
+
+// Sensors registered to be read together by run_scheduled_sensors()
+ALogScheduledSensor _scheduled_sensors[ALOG_MAX_SCHEDULED_SENSORS];
+uint8_t _n_scheduled_sensors = 0;
+
+// How the distance is estimated from a burst of ultrasonic pings
+uint8_t _ultrasonic_estimator = ULTRASONIC_MEAN;
+// Adaptive ultrasonic bursts: stop once the standard error of the mean is
+// below this target [mm]; 0 = always take all of the pings
+float _ultrasonic_target_standard_error_mm = 0;
+uint8_t _ultrasonic_min_pings = 3;
 
 // Generic output from an ASCII char array
 //char ASCII_out[100];
@@ -271,9 +518,60 @@ SdFile headerfile; // Holds header data; re-printed on each reboot for a full
                    // history of the logger's activity and to see if it has
                    // rebooted while in the field (e.g., due to the
                    // watchdog timer rescuing it from hanging)
+SdFile rawfile; // Every reading, when aggregating with set_aggregation()
+SdFile binaryfile; // Compressed data, with set_binary_output()
 
 DateTime now;
 
+// RTC time cache: the clock is read over I2C once per wake, and later times
+// in the same logging cycle are extrapolated with millis() (see _rtcNow()).
+// millis() stops in power-down sleep, so the cache is dropped on each wake.
+#define RTC_CACHE_MAX_AGE_MS 60000UL
+uint32_t _rtc_cache_unixtime;
+unsigned long _rtc_cache_millis;
+bool _rtc_cache_valid = false;
+// True when _rtc_cache_millis is the instant at which the RTC's second
+// began (an alarm wake), so that extrapolated times are good to the
+// millisecond; see _rtcAnchorToAlarm()
+bool _rtc_cache_disciplined = false;
+uint16_t _rtc_now_ms; // Milliseconds past the second of the last _rtcNow()
+
+// Sub-second timestamps (see set_subsecond_timestamps()): the alarm wakes
+// the logger exactly as the RTC's seconds roll over, so millis() at the
+// wake-up interrupt marks the start of a known second
+bool _subsecond_timestamps = false;
+volatile unsigned long _alarm_wake_millis;
+volatile bool _alarm_wake_captured = false;
+
+DateTime _rtcNow(bool refresh=false){
+  // Current time from the cache, reading the RTC only if the cache is empty,
+  // too old to extrapolate from, or a fresh reading is requested. A cache
+  // anchored on an alarm is exact, so it is not read again when a fresh
+  // reading is requested.
+  if ((refresh && !_rtc_cache_disciplined) || !_rtc_cache_valid || \
+      (millis() - _rtc_cache_millis) > RTC_CACHE_MAX_AGE_MS){
+    _rtc_cache_unixtime = RTC.now().unixtime();
+    _rtc_cache_millis = millis();
+    _rtc_cache_valid = true;
+    _rtc_cache_disciplined = false;
+  }
+  unsigned long elapsed_millis = millis() - _rtc_cache_millis;
+  _rtc_now_ms = elapsed_millis % 1000;
+  return DateTime(_rtc_cache_unixtime + elapsed_millis/1000);
+}
+
+void _rtcAnchorToAlarm(){
+  // Anchor the cache on the second at which the alarm woke the logger.
+  // The RTC is read a few milliseconds after that; whole seconds that have
+  // passed since are taken back off.
+  unsigned long read_millis = millis();
+  uint32_t unixtime = RTC.now().unixtime();
+  _rtc_cache_unixtime = unixtime - (read_millis - _alarm_wake_millis)/1000;
+  _rtc_cache_millis = _alarm_wake_millis;
+  _rtc_cache_valid = true;
+  _rtc_cache_disciplined = true;
+}
+
 /////////////////////////////////
 /////////////////////////////////
 //// ALOG LIBRARY COMPONENTS ////
@@ -402,28 +700,15 @@ void ALog::initialize(char* _logger_name, char* _datafilename, \
   // Logger models and setup //
   /////////////////////////////
 
-  Serial.print("Logger model = ");
-  #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_PRE_V200)
-    Serial.println("ALog BottleLogger pre-v2.0.0");
-  #elif defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V2)
-    Serial.println("ALog BottleLogger v2.X.Y");
-  #elif defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3)
-    Serial.println("ALog BottleLogger v3.X.Y");
-  #elif defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) \
-          || defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__)
-    Serial.print("ATMega168/328 Arduino ");
-    Serial.println("e.g., Uno with or without ALog shield)");
-  #elif defined(__AVR_ATmega644P__) || defined(__AVR_ATmega1284p__) || (__AVR_ATmega644__)
-  Serial.print("ATMega644 or ATMega1284 ");
-    #elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-    Serial.println("ATMega1280/2560 Arduino Mega");
-  #else
+  Serial.print(F("Logger model = "));
+  Serial.println((const __FlashStringHelper*)BOARD_NAME);
+  if (!BOARD.supported){
     Serial.println(F("Error: Arduino model not recognized by the ALog library."));
     Serial.println(F("Please add support for it and/or contact the developers."));
     Serial.println(F("info@northernwidget.com"));
     LEDwarn(100); // 100 quick flashes of the LED
     sleepNow(); // Do nothing until reset
-  #endif
+  }
 
   // From weather station code For power savings
   // http://jeelabs.net/projects/11/wiki/Weather_station_code
@@ -468,32 +753,50 @@ void ALog::setupLogger(){
   // "DEFAULT" (VCC), UNLESS you are  absolutely sure that you need to and the
   // 3.3V regulator connected to the AREF pin is off. Otherwise, you will short
   // 1.1V (or VCC) against 3.3V and likely damage the MCU / fry the ADC(?)
-  analogReference(EXTERNAL);
+  analogReference(BOARD.analog_reference);
 
   //////////////
   // SET PINS //
   //////////////
 
-  pinMode(wakePin,INPUT); // Interrupt to wake up
-  digitalWrite(wakePin,HIGH); // enable internal 20K pull-up
+  // Pins that this board does not have are -1: pinMode() must not see them
+  if (wakePin >= 0){
+    pinMode(wakePin,INPUT); // Interrupt to wake up
+    digitalWrite(wakePin,HIGH); // enable internal 20K pull-up
+  }
   // Set the rest of the pins
-  pinMode(CSpin,OUTPUT);
-  pinMode(SensorPowerPin,OUTPUT);
-  digitalWrite(SensorPowerPin,HIGH);
-  #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3) 
-  pinMode(EXT_3V3,OUTPUT);
-  pinMode(EXT_5V0,OUTPUT);
-  pinMode(REF_1V8,OUTPUT);
-  digitalWrite(EXT_3V3,LOW);
-  digitalWrite(EXT_5V0,HIGH);
-  digitalWrite(REF_1V8,HIGH);
-  #endif
-  pinMode(LEDpin,OUTPUT);
-  pinMode(SDpowerPin,OUTPUT);
-  pinMode(RTCpowerPin,OUTPUT);
+  if (CSpin >= 0){
+    pinMode(CSpin,OUTPUT);
+  }
+  if (ALOG_PIN(SensorPowerPin) >= 0){
+    pinMode(ALOG_PIN(SensorPowerPin),OUTPUT);
+  }
+  if (ALOG_PIN(EXT_3V3) >= 0){
+    pinMode(ALOG_PIN(EXT_3V3),OUTPUT);
+  }
+  if (ALOG_PIN(EXT_5V0) >= 0){
+    pinMode(ALOG_PIN(EXT_5V0),OUTPUT);
+  }
+  if (ALOG_PIN(REF_1V8) >= 0){
+    pinMode(ALOG_PIN(REF_1V8),OUTPUT);
+  }
+  // All rails on, counted as one user of each (see rail_on()), so that the
+  // library's own rail_on() / rail_off() pairs leave them on
+  rails_up(RAIL_ALL);
+  if (ALOG_PIN(LEDpin) >= 0){
+    pinMode(ALOG_PIN(LEDpin),OUTPUT);
+  }
+  if (ALOG_PIN(SDpowerPin) >= 0){
+    pinMode(ALOG_PIN(SDpowerPin),OUTPUT);
+  }
+  if (ALOG_PIN(RTCpowerPin) >= 0){
+    pinMode(ALOG_PIN(RTCpowerPin),OUTPUT);
+  }
   // Manual wake pin
-  pinMode(manualWakePin,INPUT); // LOG NOW button
-  digitalWrite(manualWakePin,HIGH); // enable internal 20K pull-up
+  if (manualWakePin >= 0){
+    pinMode(manualWakePin,INPUT); // LOG NOW button
+    digitalWrite(manualWakePin,HIGH); // enable internal 20K pull-up
+  }
   // Have Sensor Power set HIGH, because if any I2C sensors are attached
   // and unpowered, they will drag down the signal from the RTC, and the
   // logger will not properly initialize
@@ -513,6 +816,7 @@ void ALog::setupLogger(){
   ///////////////////
 
   Wire.begin();
+  Wire.setClock(_i2c_clock_Hz);
   Wire.setTimeout(100);
 
   /////////////////
@@ -529,43 +833,30 @@ void ALog::setupLogger(){
   Clock.checkIfAlarm(1); //Clear alarm flags
   Clock.checkIfAlarm(2); //Clear alarm flags
 
-  //uint32_t seconds_now;
-  //uint32_t seconds_at_alarm;
-  uint32_t SECONDS_FROM_1970_TO_2000 = 946684800;
   uint32_t unixtime_now;
-  uint32_t log_interval_seconds;
-  uint32_t unixtime_at_next_log;
 
   // First, what time is it now?
-  now = RTC.now();
-
-  // Second, what is the next time on which we fall on an integer of the
-  // logging interval?
-  // Always act as if logging started at Midnight on Jan 1, 1970, to ensure
-  // that even terrible, irregular logging intervals produce times that
-  // line up with one anohter
-  // Note: no leap seconds!
+  now = _rtcNow(true);
   unixtime_now = now.unixtime();
-  log_interval_seconds = hourInterval*3600 + minInterval*60 + secInterval;
-  unixtime_at_next_log = unixtime_now + log_interval_seconds - \
-                         (unixtime_now % log_interval_seconds);
-  // Ensure we have enough time to not pass the logging event accidentally
-  // 5 seconds is way more than needed, but better safe than sorry...
-  if (unixtime_at_next_log - unixtime_now < 5){
-    unixtime_at_next_log += log_interval_seconds;
-  }
-  // Create a new object
-  DateTime t_nextLog = unixtime_at_next_log;
-  _hours = t_nextLog.hour();
-  _minutes = t_nextLog.minute();
-  _seconds = t_nextLog.second();
 
-  alarm(_hours, _minutes, _seconds);  //Set first alarm.
+  // Then set the alarm, at least 5 seconds ahead so as not to pass the
+  // logging event accidentally. 5 seconds is way more than needed, but
+  // better safe than sorry...
+  alarm_aligned(unixtime_now, \
+                hourInterval*3600UL + minInterval*60UL + secInterval, 5);
 
   displayAlarms();  // Verify Alarms and display time
 
   delay(10);
 
+  ///////////////////////////////////////////
+  // BACKGROUND WIND AND RAIN ACCUMULATORS //
+  ///////////////////////////////////////////
+
+  // Start counting now; the first interval reported runs from here
+  _accumulation_start_unixtime = unixtime_now;
+  accumulators_awake();
+
   ///////////////////
   // SD CARD SETUP //
   ///////////////////
@@ -597,6 +888,12 @@ void ALog::setupLogger(){
 
   start_logging_to_datafile();
   start_logging_to_headerfile();
+  if (_aggregate_keep_raw){
+    start_logging_to_rawfile();
+  }
+  if (_binary){
+    start_logging_to_binaryfile();
+  }
 
   name();
   Serial.println(F("Logger initialization complete! Ciao bellos."));
@@ -634,6 +931,7 @@ void ALog::set_LEDpin(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
   LEDpin = _pin;
+  _custom_pins |= CUSTOM_LEDpin;
 }
 
 void ALog::set_SDpowerPin(int8_t _pin){
@@ -647,6 +945,7 @@ void ALog::set_SDpowerPin(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    SDpowerPin = _pin;
+   _custom_pins |= CUSTOM_SDpowerPin;
 }
 
 void ALog::set_RTCpowerPin(int8_t _pin){
@@ -661,6 +960,7 @@ void ALog::set_RTCpowerPin(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    RTCpowerPin = _pin;
+   _custom_pins |= CUSTOM_RTCpowerPin;
 }
 
 void ALog::set_SensorPowerPin(int8_t _pin){
@@ -676,6 +976,284 @@ void ALog::set_SensorPowerPin(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    SensorPowerPin = _pin;
+   _custom_pins |= CUSTOM_SensorPowerPin;
+}
+
+uint16_t ALog::get_min_free_ram(){
+  /**
+   * @brief Smallest amount of free RAM [bytes] between the stack and the
+   * global variables and heap since the logger booted.
+   *
+   * @details
+   * This is the stack's "high-water mark": if it approaches 0, the stack has
+   * come close to overwriting other data, and sensors or features should be
+   * removed (or their settings, e.g., ping counts, reduced). It is written to
+   * header.txt after the first logging event after each boot, and may also
+   * be recorded with the data.
+   *
+   * Example:
+   * ```
+   * alog.record((int)alog.get_min_free_ram(), "Minimum free RAM [bytes]");
+   * ```
+   */
+  uint8_t *p = (__brkval == 0) ? &_end : (uint8_t*)__brkval;
+  uint16_t nfree = 0;
+  while (p <= &__stack && *p == STACK_PAINT_BYTE){
+    nfree++;
+    p++;
+  }
+  return nfree;
+}
+
+void ALog::set_ultrasonic_estimator(uint8_t estimator){
+  /**
+   * @brief Set how the distance is estimated from a burst of ultrasonic pings.
+   *
+   * @details
+   * Applies to ultrasonicMB_analog_1cm, maxbotixHRXL_WR_analog, and
+   * maxbotixHRXL_WR_Serial. Snow, rain, and vegetation produce outliers that
+   * pull the mean; the robust estimators reject these, so fewer pings (and
+   * less time with the sensor powered) are needed for the same quality.
+   * * ULTRASONIC_MEAN: mean of all pings (default)
+   * * ULTRASONIC_MEDIAN: median
+   * * ULTRASONIC_TRIMMED_MEAN: mean after dropping the lowest and highest
+   *   quarter of the pings
+   * * ULTRASONIC_MAD_FILTERED_MEAN: mean of the pings within 3 scaled median
+   *   absolute deviations (3 * 1.4826 * MAD) of the median
+   *
+   * The robust estimators use the most recent ULTRASONIC_ROBUST_BUFFER_SIZE
+   * (15) pings of each burst; for a longer burst, the median is instead a
+   * streaming estimate over all of its pings, started from the exact median
+   * of the first 15. The standard deviation column is still
+   * computed from all pings, and the header names the estimator used.
+   * Run this, if needed, before setupLogger()
+   *
+   * Example:
+   * ```
+   * alog.set_ultrasonic_estimator(ULTRASONIC_MEDIAN);
+   * ```
+   */
+   _ultrasonic_estimator = estimator;
+}
+
+void ALog::set_ultrasonic_adaptive(float target_standard_error_mm, \
+                                   uint8_t min_pings){
+  /**
+   * @brief Stop analog ultrasonic bursts early once the estimate converges.
+   *
+   * @details
+   * Applies to ultrasonicMB_analog_1cm and maxbotixHRXL_WR_analog. Each ping
+   * keeps the sensor on for 100 ms; on a calm surface, a few pings give as
+   * good a distance as the full burst. With this set, the burst stops as soon
+   * as the standard error of the mean drops below the target, after at least
+   * min_pings pings; the "nping" passed to the sensor function becomes the
+   * maximum. Rough surfaces (wind, snowfall) still get the full burst.
+   *
+   * An extra column records the number of pings actually used. If writeAll
+   * is true, pings not taken are written as -9999 so that the columns
+   * remain aligned with the header.
+   *
+   * @param target_standard_error_mm Standard error of the mean at which to
+   * stop [mm]; set to 0 (default) to always take all of the pings.
+   *
+   * @param min_pings Minimum number of pings to take (at least 2).
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * Example:
+   * ```
+   * // Stop at 2 mm standard error, but take at least 4 pings
+   * alog.set_ultrasonic_adaptive(2, 4);
+   * ```
+   */
+   _ultrasonic_target_standard_error_mm = target_standard_error_mm;
+   _ultrasonic_min_pings = max(min_pings, (uint8_t)2);
+}
+
+void ALog::set_aggregation(uint32_t window_seconds, uint8_t nvalues, \
+                           bool keep_raw){
+  /**
+   * @brief Write statistics over a time window instead of every reading.
+   *
+   * @details
+   * For sites that sample every few seconds but need only, e.g., 15-minute
+   * statistics: each value in the line is accumulated across logging
+   * events, and one line is written to the data file per window. It holds
+   * the time at which the window started and, for each value, its mean,
+   * minimum, maximum, standard deviation, and number of readings (readings
+   * of -9999 are left out). Text values (from record()) have no statistics.
+   * Windows start on multiples of window_seconds since midnight, Jan 1,
+   * 1970, and a window's line is written at the first logging event after
+   * it ends. The serial monitor still shows every reading.
+   *
+   * Statistics take 23 bytes of RAM per value.
+   *
+   * @param window_seconds Length of each window [s]
+   *
+   * @param nvalues Number of values in each line (not counting the time
+   * stamp) to keep statistics for
+   *
+   * @param keep_raw true to also write every reading to "raw.txt"
+   *
+   * Turns off set_binary_output(): the two cannot be used together.
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * Example:
+   * ```
+   * // 15-minute statistics of 3 values, keeping the raw readings too
+   * alog.set_aggregation(900, 3, true);
+   * ```
+   */
+   if (!_aggregation.begin(window_seconds, nvalues)){
+     Serial.println(F("Not enough RAM for statistics: writing every reading"));
+     return;
+   }
+   if (_binary){
+     Serial.println(F("Statistics replace compressed data: writing text"));
+     delete _binary;
+     _binary = NULL;
+   }
+   _aggregate_keep_raw = keep_raw;
+}
+
+void ALog::set_line_buffer_length(uint16_t characters){
+  /**
+   * @brief Set the length of the buffer in which each line of data is
+   * assembled.
+   *
+   * @details
+   * Each line of data is written to the card, and to serial, in one piece
+   * once it is complete, so that nothing else (e.g., a rain gauge bucket
+   * tip record) can be written between its parts. The buffer holds
+   * ALOG_LINE_BUFFER_LENGTH (128) characters, including the line end,
+   * unless this sets another length. A longer line is written in pieces;
+   * when this happens, header.txt says how long the longest line was.
+   *
+   * The buffer takes this many bytes of RAM.
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * @param characters Length of the longest line, including its line end
+   * (2 characters)
+   *
+   * Example:
+   * ```
+   * // Twenty values of up to 9 characters each, plus their commas
+   * alog.set_line_buffer_length(220);
+   * ```
+   */
+  if (!_line.set_length(characters)){
+    Serial.println(F("Not enough RAM for the line buffer: writing data \
+straight through"));
+  }
+}
+
+void ALog::set_binary_output(){
+  /**
+   * @brief Write data compressed, to "data.bin", instead of as text.
+   *
+   * @details
+   * For long deployments: a line of slowly changing readings takes 4-8
+   * times fewer bytes, so the card fills and is written to that much more
+   * slowly. Decode data.bin on a computer with doc/decodeBinary.py, which
+   * writes the values as comma-separated text, each with the decimal places
+   * that the data file would have given it; the column labels are in
+   * header.txt as usual. The serial monitor still
+   * shows the data as text.
+   *
+   * Each number is stored as an integer, with as many decimal places as
+   * would have been written as text, and as the (zigzag varint) difference
+   * from the value in the same column in the line before; the time stamp
+   * is stored as the number of seconds since the line before. Every
+   * ALOG_BINARY_BLOCK_LINES lines, after each reboot, and whenever the
+   * number of values or decimal places changes, a new block starts with
+   * whole values, so that a damaged block loses only its own lines. Text
+   * (from record()) and values after the first ALOG_BINARY_MAX_VALUES in
+   * a line are not stored. Turns off set_aggregation(): the two cannot be
+   * used together.
+   *
+   * Format of data.bin, with "varint" an unsigned LEB128 integer and
+   * "zigzag" a signed integer n stored as the varint (n << 1) ^ (n >> 31):
+   * * Block start: varint 1; byte: number of values, n; n bytes: decimal
+   *   places of each value; varint: UNIX time; n zigzag: values
+   * * Line: varint: (seconds since the line before) << 1; n zigzag:
+   *   differences from the values in the line before
+   *
+   * Takes 171 bytes of RAM.
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * Example:
+   * ```
+   * alog.set_binary_output();
+   * ```
+   */
+   if (_aggregation.active()){
+     Serial.println(F("Compressed data replace statistics: writing every \
+reading"));
+     _aggregation.end();
+     _aggregate_keep_raw = false;
+   }
+   if (_binary == NULL){
+     _binary = new ALogBinaryEncoder;
+   }
+   if (_binary == NULL){
+     Serial.println(F("Not enough RAM for compressed data: writing text"));
+   }
+}
+
+void ALog::set_subsecond_timestamps(bool on){
+  /**
+   * @brief Write timestamps to the millisecond.
+   *
+   * @details
+   * UNIX time stamps in the data file, bucket_tips.txt, and camera.txt get
+   * a fractional part, e.g., "1538422930.125", so that events within one
+   * second (fast logging, bursts of bucket tips) keep their order and
+   * spacing.
+   *
+   * The time within the second is measured from the alarm that woke the
+   * logger, which goes off exactly as the RTC's second begins, and needs no
+   * extra reads of the clock. When the logger was woken some other way
+   * (e.g., the LOG NOW button, a bucket tip), or is not using sleep mode,
+   * that instant is not known, and whole seconds are written as before.
+   * Times are good to the MCU's wake-up time (a few ms).
+   *
+   * @param on true for millisecond timestamps; false (default) for whole
+   * seconds
+   *
+   * Example:
+   * ```
+   * alog.set_subsecond_timestamps(true);
+   * ```
+   */
+   _subsecond_timestamps = on;
+}
+
+void ALog::set_I2C_clock(uint32_t Hz){
+  /**
+   * @brief Set the I2C bus speed.
+   *
+   * @details
+   * The I2C bus (clock, and any I2C sensors on the screw terminals) runs at
+   * 100 kHz unless this sets another speed. 400 kHz makes each I2C
+   * transfer (e.g., re-arming the clock's alarms at every logging event)
+   * about four times shorter, where the wiring allows it: short cables to
+   * any I2C sensors, or none at all.
+   *
+   * @param Hz I2C clock frequency [Hz]
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * Example:
+   * ```
+   * // No long I2C sensor cables: use fast mode
+   * alog.set_I2C_clock(400000);
+   * ```
+   */
+   _i2c_clock_Hz = Hz;
+   Wire.setClock(_i2c_clock_Hz);
 }
 
 void ALog::set_EXT_3V3(int8_t _pin){
@@ -691,6 +1269,7 @@ void ALog::set_EXT_3V3(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    EXT_3V3 = _pin;
+   _custom_pins |= CUSTOM_EXT_3V3;
 }
 
 void ALog::set_EXT_5V0(int8_t _pin){
@@ -706,6 +1285,7 @@ void ALog::set_EXT_5V0(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    EXT_5V0 = _pin;
+   _custom_pins |= CUSTOM_EXT_5V0;
 }
 
 void ALog::set_REF_1V8(int8_t _pin){
@@ -718,6 +1298,7 @@ void ALog::set_REF_1V8(int8_t _pin){
    * Run this, if needed, before setupLogger()
    */
    REF_1V8 = _pin;
+   _custom_pins |= CUSTOM_REF_1V8;
 }
 
 
@@ -768,16 +1349,34 @@ float ALog::get_5V_measured_voltage(){
 // PRIVATE FUNCTIONS: UTILITIES FOR LOGGER LIBRARY //
 /////////////////////////////////////////////////////
 
+// Names of the system pins, in flash, for pinUnavailable()
+const char PIN_NAME_CSpin[] PROGMEM = "CSpin";
+const char PIN_NAME_SensorPowerPin[] PROGMEM = "SensorPowerPin";
+const char PIN_NAME_EXT_3V3[] PROGMEM = "EXT_3V3";
+const char PIN_NAME_EXT_5V0[] PROGMEM = "EXT_5V0";
+const char PIN_NAME_REF_1V8[] PROGMEM = "REF_1V8";
+const char PIN_NAME_SDpowerPin[] PROGMEM = "SDpowerPin";
+const char PIN_NAME_RTCpowerPin[] PROGMEM = "RTCpowerPin";
+const char PIN_NAME_LEDpin[] PROGMEM = "LEDpin";
+const char PIN_NAME_wakePin[] PROGMEM = "wakePin";
+const char PIN_NAME_MISOpin[] PROGMEM = "MISOpin";
+const char PIN_NAME_MOSIpin[] PROGMEM = "MOSIpin";
+const char PIN_NAME_SCKpin[] PROGMEM = "SCKpin";
+const char PIN_NAME_SDApin[] PROGMEM = "SDApin";
+const char PIN_NAME_SCLpin[] PROGMEM = "SCLpin";
+
 void ALog::pinUnavailable(uint8_t pin){
   int _errorFlag = 0;
 
-  char* _pinNameList_crit[9] = {"CSpin", "SensorPowerPin", "EXT_3V3", "EXT_5V0", "REF_1V8", "SDpowerPin", \
-                                "RTCpowerPin", "LEDpin", "wakePin"};
+  const char* const _pinNameList_crit[9] = {PIN_NAME_CSpin, \
+      PIN_NAME_SensorPowerPin, PIN_NAME_EXT_3V3, PIN_NAME_EXT_5V0, \
+      PIN_NAME_REF_1V8, PIN_NAME_SDpowerPin, PIN_NAME_RTCpowerPin, \
+      PIN_NAME_LEDpin, PIN_NAME_wakePin};
   int _pinList_crit[9] = {CSpin, SensorPowerPin, EXT_3V3, EXT_5V0, REF_1V8, SDpowerPin, RTCpowerPin, \
                           LEDpin, wakePin};
 
-  char* _pinNameList[9] = {"MISOpin", "MOSIpin", "SCKpin", "SDApin", \
-                           "SCLpin"};
+  const char* const _pinNameList[9] = {PIN_NAME_MISOpin, PIN_NAME_MOSIpin, \
+      PIN_NAME_SCKpin, PIN_NAME_SDApin, PIN_NAME_SCLpin};
   int _pinList[9] = {MISOpin, MOSIpin, SCKpin, SDApin, SCLpin};
 
   for (int i=0; i<9; i++){
@@ -786,7 +1385,7 @@ void ALog::pinUnavailable(uint8_t pin){
       Serial.print(F("Error: trying to alter the state of Pin "));
       Serial.println(_pinList[i]);
       Serial.print(F("This pin is assigned in a system-critical role as: "));
-      Serial.println(_pinNameList[i]);
+      Serial.println((const __FlashStringHelper*)_pinNameList[i]);
       // Note: numbers >13 in standard Arduino are analog pins
     }
   }
@@ -809,7 +1408,7 @@ void ALog::pinUnavailable(uint8_t pin){
       Serial.print(F("Error: trying to alter the state of Pin "));
       Serial.println(_pinList_crit[i]);
       Serial.print(F("This pin is assigned in a system-critical role as: "));
-      Serial.println(_pinNameList_crit[i]);
+      Serial.println((const __FlashStringHelper*)_pinNameList_crit[i]);
       // Note: numbers >13 in standard Arduino are analog pins
     }
   }
@@ -880,6 +1479,7 @@ void ALog::sleepNow()         // here we put the arduino to sleep
     }
       //Serial.print(F("interrupt"));  delay(10);
     if (hourInterval || minInterval || secInterval != -1){
+      _alarm_wake_captured = false;
       attachInterrupt(digitalPinToInterrupt(wakePin), wakeUpNow, LOW); // wakeUpNow when wakePin goes LOW
       //Serial.println(F(" attached")); delay(10);
     }
@@ -888,6 +1488,14 @@ void ALog::sleepNow()         // here we put the arduino to sleep
       attachInterrupt(digitalPinToInterrupt(3), wakeUpNow_tip, LOW);
     }
 
+    // Background wind and rain counters switch to level-triggered
+    // interrupts, the only kind that can wake the MCU from power-down
+    bool accumulating = (_wind_accumulator_pin != -1) || \
+                        (_rain_accumulator_pin != -1);
+    if (accumulating){
+      accumulators_asleep();
+    }
+
 /*    sleep_mode();            // here the device is actually put to sleep!!
 
                             // THE PROGRAM CONTINUES FROM HERE AFTER WAKING UP.
@@ -898,10 +1506,26 @@ void ALog::sleepNow()         // here we put the arduino to sleep
 
  */
 
-    sleep_bod_disable();
+    // A rotation, bucket tip, or watchdog tick from the accumulators wakes
+    // the MCU only long enough to count it; go back to sleep until it is
+    // time to log. Interrupts are off between the check and sleep_cpu() so
+    // that a wake-up cannot slip in between them.
+    do {
+      sleep_enable();
+      sleep_bod_disable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+      if (accumulating){
+        cli();
+      }
+    } while (accumulating && !IS_LOGGING && !NEW_RAIN_BUCKET_TIP);
     sei();
-    sleep_cpu();
-    sleep_disable();
+
+    if (accumulating){
+      wdt_disable(); // Stop the ~1 s tick; startLogging() re-enables the WDT
+      accumulators_awake();
+    }
 
     // detachInterrupt(1); // crude, but keeps interrupts from clashing. Need to improve this to allow both measurements types!
     // 06-11-2015: The above line commented to allow the rain gage to be read
@@ -919,6 +1543,11 @@ void wakeUpNow()        // here the interrupt is handled after wakeup
   // timers and code using timers (serial.print and more...) will not work here.
   // we don't really need to execute any special functions here, since we
   // just want the thing to wake up
+  if (!_alarm_wake_captured){
+    // The level-triggered interrupt repeats until detached: keep the first
+    _alarm_wake_millis = millis();
+    _alarm_wake_captured = true;
+  }
   IS_LOGGING = true;                   // Currently logging
                                        //    this will allow the logging
                                        //    to happen even if the logger is
@@ -942,6 +1571,34 @@ void wakeUpNow_tip()        // here the interrupt is handled after wakeup
   }
 }
 
+void ALog::alarm_aligned(uint32_t unixtime_now, uint32_t interval_seconds, \
+                         uint8_t min_lead_seconds){
+  // Set the alarm for the next time on which we fall on an integer of the
+  // logging interval.
+  // Always act as if logging started at Midnight on Jan 1, 1970, to ensure
+  // that even terrible, irregular logging intervals produce times that
+  // line up with one anohter
+  // Note: no leap seconds!
+  uint32_t unixtime_at_next_log = unixtime_now + interval_seconds - \
+                                  (unixtime_now % interval_seconds);
+  // Ensure we have enough time to not pass the logging event accidentally
+  if (unixtime_at_next_log - unixtime_now < min_lead_seconds){
+    unixtime_at_next_log += interval_seconds;
+  }
+  // Create a new object
+  DateTime t_nextLog = unixtime_at_next_log;
+  _hours = t_nextLog.hour();
+  _minutes = t_nextLog.minute();
+  _seconds = t_nextLog.second();
+
+  alarm(_hours, _minutes, _seconds);
+}
+
+uint8_t _decToBcd(uint8_t val){
+  // Binary-coded decimal, as the DS3231 registers hold time
+  return ((val / 10) << 4) | (val % 10);
+}
+
 void ALog::alarm(uint8_t _hours, uint8_t _minutes, uint8_t _seconds){
 
   /* Alarm bit info:
@@ -985,30 +1642,42 @@ void ALog::alarm(uint8_t _hours, uint8_t _minutes, uint8_t _seconds){
 
   SDon_RTCon();
 
-  byte AlarmBits = 0b01001000;
-  Clock.turnOffAlarm(1); //Turn off alarms before setting.
-  Clock.turnOffAlarm(2);
-
-  Clock.checkIfAlarm(1); //Clear alarm flags, do I need to do this here?
-  Clock.checkIfAlarm(2); //Clear alarm flags
-
-  // This is the primary alarm
-  Clock.setA1Time(0, _hours, _minutes, _seconds, AlarmBits, true, false, false);
-  delay(2);
-
-  // This is a backup alarm that will wake the logger in case it misses the
-  // first alarm for some unknown reason
+  // Alarm 1 is the primary alarm: hours, minutes, and seconds match.
+  // Alarm 2 is a backup alarm that will wake the logger in case it misses
+  // the first alarm for some unknown reason: hours and minutes match.
+  // (AlarmBits = 0b01001000 in the notation above, with Dy set.)
   uint8_t _hours_backup = _hours;
   uint8_t _minutes_backup = _minutes+2;
 
   if(_minutes_backup > 59){_minutes_backup = _minutes_backup - 60; _hours_backup++;}
   if(_hours_backup > 23){_hours_backup = _hours_backup - 24;}
-  Clock.setA2Time(0, _hours_backup, _minutes_backup, AlarmBits, true, false, false);  //setting as backup wake function
-  delay(2);
-  Clock.turnOnAlarm(1); //Turn on alarms.
-  delay(1);
-  Clock.turnOnAlarm(2);
-  delay(1);
+
+  // Read the control and status registers, then set both alarms, enable
+  // their interrupts, and clear their flags in a single burst write of
+  // registers 0x07-0x0F
+  uint8_t control = DS3231_CONTROL_DEFAULT; // If it cannot be read
+  uint8_t status = 0;
+  Wire.beginTransmission(DS3231_ADDRESS);
+  Wire.write(DS3231_CONTROL_REGISTER);
+  Wire.endTransmission(false);
+  if (Wire.requestFrom((uint8_t)DS3231_ADDRESS, (uint8_t)2) == 2){
+    control = Wire.read();
+    status = Wire.read();
+  }
+  Wire.beginTransmission(DS3231_ADDRESS);
+  Wire.write(DS3231_ALARM1_REGISTER);
+  Wire.write(_decToBcd(_seconds)); // A1M1 = 0
+  Wire.write(_decToBcd(_minutes)); // A1M2 = 0
+  Wire.write(_decToBcd(_hours)); // A1M3 = 0, 24-hour clock
+  Wire.write(0xC0); // A1M4 = 1, DY/DT = 1: any day
+  Wire.write(_decToBcd(_minutes_backup)); // A2M2 = 0
+  Wire.write(_decToBcd(_hours_backup)); // A2M3 = 0, 24-hour clock
+  Wire.write(0xC0); // A2M4 = 1, DY/DT = 1: any day
+  // Oscillator on (EOSC = 0); INTCN, A2IE, A1IE on
+  Wire.write((control & 0x7F) | 0x07);
+  // Clear A2F and A1F
+  Wire.write(status & ~0x03);
+  Wire.endTransmission();
   //Serial.print(' '); Using Serial to fix code from freezing; don't understand.
   // Have looked through HW Serial, Print, Stream libraries; can't tell why yet
   // (was a <15 minute look)
@@ -1112,11 +1781,14 @@ void ALog::checkAlarms(){
   bool Apm;
   bool A12h = false;
 
-	Clock.checkIfAlarm(1);
+	if (Clock.checkIfAlarm(1) && _alarm_wake_captured){
+	  // Woken by the primary alarm: time this logging event from its edge
+	  _rtcAnchorToAlarm();
+	}
 
 //if (_use_sleep_mode){  //Removed by Chad 4/20/17
   if (Clock.checkIfAlarm(2)) {
-	  Serial.println("Alarm missed! Resetting logger.");
+	  Serial.println(F("Alarm missed! Resetting logger."));
     datafile.close();
     LEDwarn(5);
     delay(30);
@@ -1137,12 +1809,13 @@ void ALog::checkAlarms(){
     bool ADy;
     bool Apm;
     byte ADay, AHour, AMinute, ASecond, AlarmBits;
-    otherfile.print(now.unixtime());
-    otherfile.print(",");
-    otherfile.print("Alarm: ");
+    now = _rtcNow();
+    print_timestamp(otherfile);
+    otherfile.print(F(","));
+    otherfile.print(F("Alarm: "));
     Clock.getA1Time(ADay, AHour, AMinute, ASecond, AlarmBits, ADy, A12h, Apm);
     otherfile.print(ADay, DEC);
-    otherfile.print(" DoW");
+    otherfile.print(F(" DoW"));
     otherfile.print(' ');
     otherfile.print(AHour, DEC);
     otherfile.print(' ');
@@ -1152,10 +1825,10 @@ void ALog::checkAlarms(){
     otherfile.print(' ');
     if (A12h) {
 	    if (Apm) {
-		    otherfile.print("PM");
+		    otherfile.print(F("PM"));
 	    }
 	    else {
-		    otherfile.print("AM");
+		    otherfile.print(F("AM"));
 	    }
     }
     end_logging_to_otherfile();
@@ -1170,7 +1843,7 @@ void ALog::displayTime(){
    Always 24-hour clock
    */
   bool PM;
-  Serial.print("UTC DATE/TIME: ");
+  Serial.print(F("UTC DATE/TIME: "));
   delay(5);
   now = RTC.now();
 	Serial.print(2000+now.year(), DEC);
@@ -1186,9 +1859,9 @@ void ALog::displayTime(){
 	//Serial.print(' ');
 	// Finally the hour, minute, and second
 	Serial.print(now.hour(), DEC);
-	Serial.print(":");
+	Serial.print(F(":"));
 	Serial.print(now.minute(), DEC);
-	Serial.print(":");
+	Serial.print(F(":"));
 	Serial.println(now.second(), DEC);
 	// Enough time to print
   delay(2);
@@ -1200,9 +1873,9 @@ void ALog::LEDwarn(uint8_t nflash)
   // has not properly initialized upon restart
   // No
   for(uint8_t i=0;i<=nflash;i++){
-    digitalWrite(LEDpin,HIGH);
+    ALOG_PIN_WRITE(LEDpin, HIGH);
     delay(40);
-    digitalWrite(LEDpin,LOW);
+    ALOG_PIN_WRITE(LEDpin, LOW);
     delay(40);
   }
 }
@@ -1210,17 +1883,17 @@ void ALog::LEDwarn(uint8_t nflash)
 void ALog::LEDgood()
 {
   // Peppy blinky pattern to show that the logger has successfully initialized
-  digitalWrite(LEDpin,HIGH);
+  ALOG_PIN_WRITE(LEDpin, HIGH);
   delay(1000);
-  digitalWrite(LEDpin,LOW);
+  ALOG_PIN_WRITE(LEDpin, LOW);
   delay(300);
-  digitalWrite(LEDpin,HIGH);
+  ALOG_PIN_WRITE(LEDpin, HIGH);
   delay(100);
-  digitalWrite(LEDpin,LOW);
+  ALOG_PIN_WRITE(LEDpin, LOW);
   delay(100);
-  digitalWrite(LEDpin,HIGH);
+  ALOG_PIN_WRITE(LEDpin, HIGH);
   delay(100);
-  digitalWrite(LEDpin,LOW);
+  ALOG_PIN_WRITE(LEDpin, LOW);
 }
 
 void ALog::LEDtimeWrong(uint8_t ncycles)
@@ -1229,42 +1902,145 @@ void ALog::LEDtimeWrong(uint8_t ncycles)
   // 1st, 2000
   for(uint8_t i=0;i<=ncycles;i++)
   {
-    digitalWrite(LEDpin,HIGH);
+    ALOG_PIN_WRITE(LEDpin, HIGH);
     delay(250);
-    digitalWrite(LEDpin,LOW);
+    ALOG_PIN_WRITE(LEDpin, LOW);
     delay(100);
-    digitalWrite(LEDpin,HIGH);
+    ALOG_PIN_WRITE(LEDpin, HIGH);
     delay(100);
-    digitalWrite(LEDpin,LOW);
+    ALOG_PIN_WRITE(LEDpin, LOW);
     delay(100);
   }
 }
 
 void ALog::unixDatestamp(){
 
+  now = _rtcNow();
+
   if (first_log_after_booting_up){
-    now = RTC.now();
     // One row for date stamp; the next for real header info
     headerfile.print(now.unixtime());
     headerfile.println();
-    headerfile.print("UNIX time stamp");
-    headerfile.print(",");
+    headerfile.print(F("UNIX time stamp"));
+    headerfile.print(F(","));
   }
 
-  now = RTC.now();
-  datafile.print(now.unixtime());
+  if (_aggregation.active()){
+    // The first line of a new window: write the statistics for the last one
+    if (_aggregation.window_ended(now.unixtime())){
+      write_aggregates();
+    }
+    _aggregation.start_line(now.unixtime());
+    _line.begin(_aggregate_keep_raw ? &rawfile : NULL);
+  }
+  else if (_binary){
+    _binary->start_line(now.unixtime());
+    _line.begin(NULL);
+  }
+  else {
+    _line.begin(&datafile);
+  }
+
+  print_timestamp(_line);
+  _line.print(F(","));
+}
+
+void ALog::write_value(float value, uint8_t decimals){
+  // Every number in the line goes through here: into the line of text (see
+  // unixDatestamp()) and, when aggregating, into the statistics for its
+  // column, or, for binary output, into the binary line
+  if (_aggregation.active()){
+    _aggregation.add(value, decimals);
+  }
+  else if (_binary){
+    _binary->add(value, decimals);
+  }
+
+  char text[FLOAT_TEXT_LENGTH];
+  _line.write(text, _formatFloat(text, value, decimals));
+  _line.print(F(","));
+}
+
+void ALog::write_text(const String &text){
+  // As write_value(), for text; text has no statistics, so its columns are
+  // -9999 in aggregated rows
+  if (_aggregation.active()){
+    _aggregation.skip();
+  }
+  _line.print(text);
+  _line.print(F(","));
+}
+
+void ALog::write_binary_line(){
+  // Encode this line into data.bin (see set_binary_output() for the format),
+  // in one write
+  uint8_t bytes[ALOG_BINARY_LINE_BYTES];
+  binaryfile.write(bytes, _binary->end_line(bytes));
+  binaryfile.sync();
+}
+
+void ALog::print_float(Print &out, float value, uint8_t decimals){
+  // As out.print(value, decimals), but faster: see _formatFloat()
+  char text[FLOAT_TEXT_LENGTH];
+  out.write(text, _formatFloat(text, value, decimals));
+}
+
+void ALog::write_aggregates(){
+  // One line for the window that has ended: its start time, then the mean,
+  // minimum, maximum, standard deviation, and number of readings of each
+  // value
+  datafile.print(_aggregation.window_start());
   datafile.print(F(","));
+  for (uint8_t i=0; i<_aggregation.nvalues(); i++){
+    ALogStats &stats = _aggregation.stats(i);
+    uint8_t decimals = _aggregation.decimals(i);
+    if (stats.count() > 0){
+      print_float(datafile, stats.mean(), decimals + 1);
+      datafile.print(F(","));
+      print_float(datafile, stats.minimum(), decimals);
+      datafile.print(F(","));
+      print_float(datafile, stats.maximum(), decimals);
+      datafile.print(F(","));
+      print_float(datafile, stats.standard_deviation(), decimals + 1);
+      datafile.print(F(","));
+    }
+    else {
+      datafile.print(F("-9999,-9999,-9999,-9999,"));
+    }
+    datafile.print(stats.count());
+    datafile.print(F(","));
+  }
+  datafile.println();
+  _aggregation.clear();
+}
 
-  // Echo to serial
-  Serial.print(now.unixtime());
-  Serial.print(F(","));
+void ALog::print_timestamp(Print &out){
+  // UNIX time of "now", as read by _rtcNow(), with milliseconds as a
+  // fractional part if sub-second timestamps are on and the time is known
+  // to the millisecond this logging event
+  out.print(now.unixtime());
+  if (_subsecond_timestamps && _rtc_cache_disciplined){
+    out.print('.');
+    if (_rtc_now_ms < 100){
+      out.print('0');
+    }
+    if (_rtc_now_ms < 10){
+      out.print('0');
+    }
+    out.print(_rtc_now_ms);
+  }
 }
 
 void ALog::endLine(){
-  // Ends the line in the file; do this at end of recording instance
-  // before going back to sleep
-  datafile.println();
-  Serial.println();
+  // Ends the line and writes it, in one piece, to the file and serial; do
+  // this at end of recording instance before going back to sleep
+  _line.commit();
+  if (_binary){
+    write_binary_line();
+  }
+  else if (_aggregate_keep_raw){
+    rawfile.sync();
+  }
 }
 
 float ALog::_vdivR(uint8_t pin, float Rref, uint8_t adc_bits, \
@@ -1272,32 +2048,34 @@ float ALog::_vdivR(uint8_t pin, float Rref, uint8_t adc_bits, \
   // Same as public vidvR code, but returns value instead of
   // saving it to a file
   float _ADC;
-  float _R;
   _ADC = analogReadOversample(pin, adc_bits, 1, oversample_debug);
   float _ADCnorm = _ADC/1023.0; // Normalize to 0-1
+  return vdiv_resistance(_ADCnorm, Rref, Rref_on_GND_side);
+}
+
+float ALog::vdiv_resistance(float ratio, float Rref, bool Rref_on_GND_side){
+  // Unknown resistance from the voltage divider's output as a fraction
+  // (0-1) of its excitation voltage
+  float _R;
   if(Rref_on_GND_side){
     // Standard case for the provided slots for reference resistors
     // This is the default.
-    _R = Rref/_ADCnorm - Rref; // R1 = (R2*Vin)/Vout - R2
+    _R = Rref/ratio - Rref; // R1 = (R2*Vin)/Vout - R2
   }
   else {
     // This could happen if an external sensor has a different setup for
     // its known and unknown resistors; in this case, place the reference
     // resistor between the analog pin and 3V3. (The sensor, internally,
     // has its thermistor connected to GND.)
-    _R = Rref * (1. / ((1./_ADCnorm) - 1.)); // R2 = R1* (1 / ((Vin/Vout) - 1))
+    _R = Rref * (1. / ((1./ratio) - 1.)); // R2 = R1* (1 / ((Vin/Vout) - 1))
   }
   return _R;
 }
 
 void ALog::SDon_RTCon(){
   // Turn on power to clock and SD card
-  #if defined(__AVR_ATmega644P__) || defined(__AVR_ATmega1284p__) || (__AVR_ATmega644__) 
-  digitalWrite(SDpowerPin,LOW);
-  #else
-  digitalWrite(SDpowerPin,HIGH); //Chad -- one model's pull-ups attached to SDpowerPin
-  #endif
-  digitalWrite(RTCpowerPin,HIGH);
+  ALOG_PIN_WRITE(SDpowerPin, !BOARD.SDpower_active_low);
+  ALOG_PIN_WRITE(RTCpowerPin, HIGH);
   delay(20);
 }
 
@@ -1308,12 +2086,8 @@ void ALog::SDoff_RTCsleep(){
   // This "tricks" it into turning off its I2C bus and saves power on the
   // board, but keeps its alarm functionality on.
   // (Idea to do this courtesy of Gerhard Oberforcher)
-  #if defined(__AVR_ATmega644P__) || defined(__AVR_ATmega1284p__) || (__AVR_ATmega644__) 
-  digitalWrite(SDpowerPin,HIGH);
-  #else
-  digitalWrite(SDpowerPin,LOW); //Chad -- one model's pull-ups attached to SDpowerPin
-  #endif
-  digitalWrite(RTCpowerPin,LOW);
+  ALOG_PIN_WRITE(SDpowerPin, BOARD.SDpower_active_low);
+  ALOG_PIN_WRITE(RTCpowerPin, LOW);
   delay(2);
 }
 
@@ -1377,6 +2151,10 @@ void ALog::startLogging(){
   sbi(ADCSRA,ADEN);        // switch Analog to Digitalconverter ON
   // Turn power on
   SDon_RTCon();
+  // millis() did not run while asleep: read the clock again this wake
+  _rtc_cache_valid = false;
+  // Measure the LTC2495 reference again, if it is used, this logging event
+  _ltc2495_reference_code = 0;
 
   checkAlarms(); //Check and clear flag
   //displayAlarms();  // Verify Alarms and display time // Here for debugging
@@ -1401,12 +2179,12 @@ void ALog::startLogging(){
     // Check if the logger has been awakend by someone pushing the button
     // If so, bypass everything else
     //Serial.println("LOG1!");
-    if (digitalRead(manualWakePin) == LOW){
+    if (manualWakePin >= 0 && digitalRead(manualWakePin) == LOW){
       // Brief light flash to show that logging is happening
       //Serial.println("LOG2!");
-      digitalWrite(LEDpin, HIGH);
+      ALOG_PIN_WRITE(LEDpin, HIGH);
       delay(5); // to make sure tips aren't double-counted
-      digitalWrite(LEDpin, LOW);
+      ALOG_PIN_WRITE(LEDpin, LOW);
       // And now note that it is logging
     }
   }
@@ -1429,6 +2207,14 @@ void ALog::startLogging(){
   delay(10);
   // Datestamp the start of the line
   unixDatestamp();
+  // Then the supply voltage, if it is watched
+  if (_battery_watch){
+    record_supply_voltage();
+  }
+  // Then the wind and rain that were counted in the background, if any
+  if ((_wind_accumulator_pin != -1) || (_rain_accumulator_pin != -1)){
+    record_accumulators();
+  }
 }
 
 void ALog::endLogging(){
@@ -1448,6 +2234,10 @@ void ALog::endLogging(){
    * have made it long enough, but because it is hard-coded, there could be
    * an unforeseen circumstance in which it is not!
    */
+  // Any scheduled sensors that the sketch did not run itself
+  if (_n_scheduled_sensors > 0){
+    run_scheduled_sensors();
+  }
   endLine();
   // Write all of the data to the file
   // The buffer is 512 bytes -- so need to use this in-between
@@ -1469,7 +2259,7 @@ void ALog::endLogging(){
   if (NEW_RAIN_BUCKET_TIP){
     TippingBucketRainGage();
   }
-  Serial.println("LOG!"); // This is better! The more we print, the harder it is
+  Serial.println(F("LOG!")); // This is better! The more we print, the harder it is
                           // to break the system! (????!!!!)
   //Serial.write(7); // Saved by another print statement. That's 3... there must
                    // be a reason!
@@ -1482,27 +2272,50 @@ void ALog::endLogging(){
     // Check if you have passed your logging time -- perhpas the LOG NOW
     // button was pressed, and not during / slightly before (and blocking)
     // the time for the next logging
-    now = RTC.now();
+    // Read the clock itself: this decides whether the alarm is advanced, so
+    // it must not lag by the fraction of a second that extrapolation can
+    now = _rtcNow(true);
     //Calculate for next alarm
-    uint32_t seconds_in_day_now = now.hour()*3600 + now.minute()*60 + now.second();
-    // 1 second padding in order to ensure that we jump to the next alarm
-    // sooner rather than later
-    // This is especially for the use of the LOG NOW button.
-    uint32_t seconds_in_day_alarm = (_hours*3600 + _minutes*60 + _seconds - 1) % 86400;
-    if (seconds_in_day_now < seconds_in_day_alarm){
-      advance_alarm_flag = false;
+    if (_battery_state == ALOG_BATTERY_CRITICAL){
+      // Saving the battery: the normal interval, stretched (up to a day, as
+      // far as the daily alarm can reach)
+      uint32_t stretched_interval = \
+          (hourInterval*3600UL + minInterval*60UL + secInterval) * \
+          _battery_interval_multiplier;
+      alarm_aligned(now.unixtime(), min(stretched_interval, 86400UL), 2);
+    }
+    else if (_trigger_active){
+      // Burst logging after a trigger
+      alarm_aligned(now.unixtime(), _trigger_burst_interval_seconds, 2);
     }
+    else if (_trigger_released || _battery_recovered){
+      // Back to the normal schedule, on its usual times
+      alarm_aligned(now.unixtime(), \
+                    hourInterval*3600UL + minInterval*60UL + secInterval, 2);
+      _trigger_released = false;
+      _battery_recovered = false;
+    }
+    else {
+      uint32_t seconds_in_day_now = now.hour()*3600 + now.minute()*60 + now.second();
+      // 1 second padding in order to ensure that we jump to the next alarm
+      // sooner rather than later
+      // This is especially for the use of the LOG NOW button.
+      uint32_t seconds_in_day_alarm = (_hours*3600 + _minutes*60 + _seconds - 1) % 86400;
+      if (seconds_in_day_now < seconds_in_day_alarm){
+        advance_alarm_flag = false;
+      }
 
-    if (advance_alarm_flag){
-      // START HERE! MAKE THIS WORK FOR MIDNIGHT ROLLOVER
-      _hours = _hours+hourInterval;
-      _minutes = _minutes+minInterval;
-      _seconds = _seconds+secInterval;
-      if(_seconds > 59){_seconds = _seconds - 60; _minutes++;}
-      if(_minutes > 59){_minutes = _minutes - 60; _hours++;}
-      if(_hours > 23){_hours = _hours - 24;}
+      if (advance_alarm_flag){
+        // START HERE! MAKE THIS WORK FOR MIDNIGHT ROLLOVER
+        _hours = _hours+hourInterval;
+        _minutes = _minutes+minInterval;
+        _seconds = _seconds+secInterval;
+        if(_seconds > 59){_seconds = _seconds - 60; _minutes++;}
+        if(_minutes > 59){_minutes = _minutes - 60; _hours++;}
+        if(_hours > 23){_hours = _hours - 24;}
 
-      alarm(_hours, _minutes, _seconds);  //Set new alarms.
+        alarm(_hours, _minutes, _seconds);  //Set new alarms.
+      }
     }
     //displayAlarms(); // Verify Alarms and display time
     delay(2);
@@ -1513,47 +2326,443 @@ void ALog::endLogging(){
   // sketch, the sketch will cycle back back to sleep(...)
 }
 
-void ALog::sensorPowerOn(){
+// SUPPLY VOLTAGE
+//////////////////
+
+void ALog::set_battery_thresholds(float low_volts, float critical_volts, \
+                                  uint8_t interval_multiplier){
   /**
-   * @brief Turn ON power to 3V3 regulator that connects to screw terminals.
+   * @brief Measure the supply voltage each logging event, and save power
+   * when it is low.
+   *
    * @details
-   * This powers external devices.
+   * The voltage is measured at the start of each logging event, with
+   * measure_supply_voltage(), and recorded in the column after the time
+   * stamp. Below low_volts, optional_sensors_enabled() becomes false, so
+   * that the sketch can skip the sensors that it can do without. Below
+   * critical_volts, the logging interval is also stretched by
+   * interval_multiplier (up to one day), on times that are multiples of the
+   * stretched interval. The logger goes back to each better state, and to
+   * its normal schedule, once the voltage is ALOG_BATTERY_HYSTERESIS_V
+   * above the threshold, so that it does not switch back and forth on
+   * noise.
+   *
+   * Set both thresholds to 0 to record the voltage only.
+   *
+   * Only the v3 board measures the battery itself. Others measure the 3.3 V
+   * regulator's output (see measure_supply_voltage()), which never reaches
+   * battery voltages: on these, thresholds must be below
+   * ALOG_AREF_NOMINAL_VOLTAGE (3.3 V), to act when the regulator drops out.
+   * Higher thresholds are refused (with a message on serial), and the
+   * voltage is only recorded.
+   *
+   * Run this, if needed, before setupLogger()
+   *
+   * @param low_volts Supply voltage below which optional sensors are
+   * skipped [V]
+   *
+   * @param critical_volts Supply voltage below which the logging interval
+   * is stretched as well [V]
+   *
+   * @param interval_multiplier Factor by which the logging interval is
+   * stretched
+   *
+   * Example:
+   * ```
+   * // v3, 12 V lead-acid battery: skip extras below 11.8 V; below 11.4 V,
+   * // log a quarter as often
+   * alog.set_battery_thresholds(11.8, 11.4, 4);
+   * // v2: skip extras once the 3.3 V regulator sags below 3.2 V; below
+   * // 3.0 V, log a quarter as often
+   * alog.set_battery_thresholds(3.2, 3.0, 4);
+   * ```
    */
+   if (BOARD.VbattPin < 0 && \
+       max(low_volts, critical_volts) > ALOG_AREF_NOMINAL_VOLTAGE){
+     // The 3.3 V supply would be "critical" forever
+     Serial.println(F("This board measures its 3.3 V supply, not the \
+battery: battery thresholds ignored; recording the voltage only"));
+     low_volts = 0;
+     critical_volts = 0;
+     _battery_thresholds_refused = true;
+   }
+   _battery_watch = true;
+   _battery_low_volts = low_volts;
+   _battery_critical_volts = critical_volts;
+   _battery_interval_multiplier = max(interval_multiplier, (uint8_t)1);
+}
 
-  if (_use_sleep_mode){
-     digitalWrite(SensorPowerPin,HIGH);
-      #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3)
-      digitalWrite(EXT_3V3,LOW);
-      digitalWrite(EXT_5V0,HIGH);
-      digitalWrite(REF_1V8,HIGH);
-      #endif
-     delay(5);
+float ALog::measure_supply_voltage(){
+  /**
+   * @brief Measure the supply voltage [V].
+   *
+   * @details
+   * On boards with a battery voltage divider (v3), this is the battery
+   * voltage. On others, it is the voltage at AREF: the 3.3 V regulator's
+   * output, which falls with the battery once the regulator drops out.
+   * Both are found from the microcontroller's internal 1.1 V bandgap
+   * reference, read against AREF; this is nominally 1.1 V but can be off by
+   * up to 10%, so the result is good for thresholds rather than for
+   * absolute measurements unless ALOG_BANDGAP_VOLTAGE is calibrated.
+   *
+   * The 3V3 sensor rail, which feeds AREF, is held on (see rail_on()) while
+   * measuring.
+   *
+   * Returns -9999 if the measurement fails.
+   *
+   * Example:
+   * ```
+   * float V = alog.measure_supply_voltage();
+   * ```
+   */
+  // AREF is fed by the switchable 3V3 sensor regulator, which may be off
+  // (e.g., before the sketch's sensorPowerOn()): hold it on to measure
+  rail_on(RAIL_3V3, ALOG_AREF_WARMUP_MS);
+  float Vref = read_AREF_voltage();
+  float V = Vref;
+  if (BOARD.VbattPin >= 0 && Vref != -9999){
+    uint16_t sum = 0;
+    for (uint8_t i=0; i<4; i++){
+      sum += analogRead(BOARD.VbattPin);
+    }
+    V = sum / 4. / 1024. * Vref / ALOG_BATTERY_DIVIDER;
   }
-  else if (first_log_after_booting_up){
-     digitalWrite(SensorPowerPin,HIGH);
-      #if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3)  
-      digitalWrite(EXT_3V3,LOW);
-      digitalWrite(EXT_5V0,HIGH);
-      digitalWrite(REF_1V8,HIGH);
-      #endif
-     delay(5);
+  rail_off(RAIL_3V3);
+  return V;
+}
+
+bool ALog::optional_sensors_enabled(){
+  /**
+   * @brief False while the supply voltage is low: skip optional sensors.
+   *
+   * @details
+   * See set_battery_thresholds(). Always true on the first logging event
+   * after booting, so that header.txt gets the label of every column.
+   * Record -9999 for the columns of each skipped sensor, to keep the rest
+   * of the line in its columns.
+   *
+   * Example:
+   * ```
+   * if (alog.optional_sensors_enabled()){
+   *   alog.maxbotixHRXL_WR_analog();
+   * }
+   * else {
+   *   alog.record(-9999); // Mean distance
+   *   alog.record(-9999); // Standard deviation
+   * }
+   * ```
+   */
+  return first_log_after_booting_up || (_battery_state == ALOG_BATTERY_OK);
+}
+
+float ALog::read_AREF_voltage(){
+  // The bandgap, read against AREF, gives AREF. Keep the ADC on the external
+  // reference: switching to AVCC or the internal reference while AREF is
+  // driven would short them together.
+  ADMUX = BANDGAP_ADMUX; // REFS1:0 = 00: external AREF
+  #if defined(MUX5)
+    ADCSRB &= ~_BV(MUX5);
+  #endif
+  delay(2); // Let the bandgap and sample-and-hold settle
+  uint16_t reading = 0;
+  // The first conversion after switching channels is discarded
+  for (uint8_t i=0; i<2; i++){
+    ADCSRA |= _BV(ADSC);
+    while (ADCSRA & _BV(ADSC)){}
+    reading = ADC;
+  }
+  if (reading == 0){
+    return -9999;
   }
+  return ALOG_BANDGAP_VOLTAGE * 1024. / reading;
 }
 
+uint8_t ALog::battery_state_at(float volts){
+  if (volts < _battery_critical_volts){
+    return ALOG_BATTERY_CRITICAL;
+  }
+  else if (volts < _battery_low_volts){
+    return ALOG_BATTERY_LOW;
+  }
+  else {
+    return ALOG_BATTERY_OK;
+  }
+}
+
+void ALog::record_supply_voltage(){
+  // Measure, update the battery state, and record the voltage
+  _supply_voltage = measure_supply_voltage();
+  if (_supply_voltage != -9999){
+    // Worse states right away; better ones with hysteresis
+    uint8_t worse = battery_state_at(_supply_voltage);
+    uint8_t better = battery_state_at(_supply_voltage - \
+                                      ALOG_BATTERY_HYSTERESIS_V);
+    if (worse > _battery_state){
+      _battery_state = worse;
+    }
+    else if (better < _battery_state){
+      if (_battery_state == ALOG_BATTERY_CRITICAL){
+        _battery_recovered = true;
+      }
+      _battery_state = better;
+    }
+  }
+
+  if (first_log_after_booting_up){
+    headerfile.print(F("Supply voltage [V]"));
+    headerfile.print(F(","));
+    headerfile.sync();
+  }
+  write_value(_supply_voltage, 3);
+}
+
+// EVENT TRIGGER
+/////////////////
+
+void ALog::set_trigger(float threshold_on, float threshold_off, \
+                       float rate_limit_per_second, \
+                       uint16_t burst_interval_seconds){
+  /**
+   * @brief
+   * Switch to rapid logging while a sensor reading crosses a threshold or
+   * changes quickly
+   *
+   * @details
+   * For sites such as flood or debris-flow channels: log on a slow schedule,
+   * but every burst_interval_seconds while something is happening. Pass the
+   * reading to trigger() each time it is measured; the logging interval is
+   * changed at the end of that logging event.
+   *
+   * The trigger goes on when the reading passes threshold_on, or changes
+   * faster than rate_limit_per_second in either direction. It goes off only
+   * once the reading is back past threshold_off and its rate of change is
+   * below half of the limit, so that it does not flicker on and off around
+   * either. If threshold_off is below threshold_on, the trigger is for high
+   * readings (e.g., pressure from water depth); if it is above, for low
+   * readings (e.g., ultrasonic distance down to the water). Logging then
+   * returns to its normal times.
+   *
+   * Each time the trigger goes on or off, this is written to "triggers.txt",
+   * with the time, the reading, and its rate of change.
+   *
+   * Triggers work only with sleep mode (a logging interval that is not 0).
+   *
+   * @param threshold_on Reading at which the trigger goes on
+   *
+   * @param threshold_off Reading at which the trigger goes off again
+   *
+   * @param rate_limit_per_second Rate of change, in reading units per
+   * second, at which the trigger goes on; 0 to not use rate of change.
+   *
+   * @param burst_interval_seconds Logging interval while triggered [s]
+   *
+   * Example:
+   * ```
+   * // Log every 10 seconds once water is deeper than 50 cm, or rising or
+   * // falling by more than 1 cm/s, until it is shallower than 40 cm (and
+   * // steadier)
+   * alog.set_trigger(50, 40, 1, 10);
+   * // In loop(), after reading the sensor:
+   * alog.trigger(depth_cm);
+   * ```
+   */
+  _trigger_on = threshold_on;
+  _trigger_off = threshold_off;
+  _trigger_rate_limit = rate_limit_per_second;
+  _trigger_burst_interval_seconds = max(burst_interval_seconds, (uint16_t)1);
+  _trigger_enabled = true;
+}
+
+bool ALog::trigger(float value){
+  /**
+   * @brief
+   * Check a sensor reading against the trigger set with set_trigger()
+   *
+   * @details
+   * Call once per logging event, between startLogging() and endLogging(),
+   * with the reading to watch. Readings of -9999 (no data) are skipped.
+   *
+   * @param value The sensor reading
+   *
+   * Returns true while the logger is triggered.
+   *
+   * Example:
+   * ```
+   * float P = alog.Honeywell_HSC_analog(A1, 5, 3.3, 0, 30, 1, 6);
+   * alog.trigger(P);
+   * ```
+   */
+  if (!_trigger_enabled || value == -9999){
+    return _trigger_active;
+  }
+
+  uint32_t unixtime_now = now.unixtime();
+  float rate = 0;
+  if (_trigger_have_last_value && unixtime_now > _trigger_last_unixtime){
+    rate = (value - _trigger_last_value) / \
+           (float)(unixtime_now - _trigger_last_unixtime);
+  }
+  _trigger_last_value = value;
+  _trigger_last_unixtime = unixtime_now;
+  _trigger_have_last_value = true;
+
+  // Signs are flipped for a trigger on low readings
+  float sign = (_trigger_off <= _trigger_on) ? 1 : -1;
+  bool rate_on = (_trigger_rate_limit > 0) && \
+                 (fabs(rate) >= _trigger_rate_limit);
+  bool rate_off = (_trigger_rate_limit <= 0) || \
+                  (fabs(rate) < _trigger_rate_limit/2);
+
+  if (!_trigger_active && (sign*value >= sign*_trigger_on || rate_on)){
+    _trigger_active = true;
+    record_trigger(value, rate);
+  }
+  else if (_trigger_active && sign*value <= sign*_trigger_off && rate_off){
+    _trigger_active = false;
+    _trigger_released = true;
+    record_trigger(value, rate);
+  }
+  return _trigger_active;
+}
+
+void ALog::record_trigger(float value, float rate){
+  // Note a change in the trigger state in triggers.txt
+  start_logging_to_otherfile("triggers.txt");
+  print_timestamp(otherfile);
+  otherfile.print(F(","));
+  if (_trigger_active){
+    otherfile.print(F("ON"));
+  }
+  else {
+    otherfile.print(F("OFF"));
+  }
+  otherfile.print(F(","));
+  otherfile.print(value, 4);
+  otherfile.print(F(","));
+  otherfile.print(rate, 4);
+  end_logging_to_otherfile();
+}
+
+void ALog::sensorPowerOn(){
+  /**
+   * @brief Turn ON power to 3V3 regulator that connects to screw terminals.
+   * @details
+   * This powers external devices. On the ALog BottleLogger v3, this also
+   * turns on the 5V and 1.8V reference rails. To power only the rails that
+   * a particular sensor needs, and only while it needs them, see rail_on().
+   */
+
+  if (_use_sleep_mode || first_log_after_booting_up){
+     rail_on(RAIL_ALL, 5);
+  }
+}
 void ALog::sensorPowerOff(){
   /**
    * @brief Turn OFF power to 3V3 regulator that connects to screw terminals.
    * @details
-   * This cuts 3V3 power to external devices.
+   * This cuts 3V3 power to external devices, and switches off all other
+   * sensor rails too, whether or not they were turned on with rail_on().
+   * If the logger is not using sleep mode, the rails stay on between logging
+   * events.
    */
   if (_use_sleep_mode){
-     digitalWrite(SensorPowerPin,LOW);
-#if defined(ARDUINO_AVR_ALOG_BOTTLELOGGER_V3) 
-     digitalWrite(EXT_3V3,HIGH);
-     digitalWrite(EXT_5V0,LOW);
-     digitalWrite(REF_1V8,LOW);
-#endif
-     //delay(5);
+     for (uint8_t i=0; i<N_RAILS; i++){
+       _rail_users[i] = 0;
+       rail_write(i, false);
+     }
+  }
+}
+
+void ALog::rail_on(uint8_t rails, uint16_t warmup_ms){
+  /**
+   * @brief Turn on the power rails that a sensor needs, and wait for it to
+   * warm up.
+   *
+   * @details
+   * Rails are counted: each is on from its first rail_on() until the
+   * matching last rail_off(), so sensors that share a rail can each turn it
+   * on and off without cutting power to one another. Warm-up is counted
+   * from when each rail was actually switched on, so a sensor on a rail that
+   * is already warm does not wait at all.
+   *
+   * setupLogger() turns every rail on, and this counts as one user that
+   * only sensorPowerOff() releases: a sketch that never calls
+   * sensorPowerOff() keeps its sensors powered between rail_on() /
+   * rail_off() pairs, as it always has. sensorPowerOff() releases every
+   * user at once; after it, rails are on only while some sensor holds them
+   * with rail_on() or sensorPowerOn().
+   *
+   * @param rails Any combination of RAIL_3V3 (SensorPowerPin or EXT_3V3),
+   * RAIL_5V0 (EXT_5V0), and RAIL_REF_1V8 (REF_1V8), joined with "|";
+   * RAIL_ALL is all of them. Rails without a pin on this board are ignored.
+   *
+   * @param warmup_ms Time that the sensor needs after power-on [ms]
+   *
+   * Example:
+   * ```
+   * // MaxBotix on the 5V rail needs ~160 ms after power-up
+   * alog.rail_on(RAIL_5V0, 160);
+   * alog.maxbotixHRXL_WR_analog(10, A0, 99, false);
+   * alog.rail_off(RAIL_5V0);
+   * ```
+   */
+  rails_up(rails);
+  while (!rails_warm(rails, warmup_ms)){
+    delay(1);
+  }
+}
+
+void ALog::rail_off(uint8_t rails){
+  /**
+   * @brief Release power rails turned on with rail_on().
+   *
+   * @details
+   * Each rail is switched off once the last sensor using it releases it.
+   */
+  for (uint8_t i=0; i<N_RAILS; i++){
+    if ((rails & (1 << i)) && _rail_users[i] > 0){
+      _rail_users[i]--;
+      if (_rail_users[i] == 0){
+        rail_write(i, false);
+      }
+    }
+  }
+}
+
+void ALog::rails_up(uint8_t rails){
+  // Count one more user of each rail, switching on those that are off
+  for (uint8_t i=0; i<N_RAILS; i++){
+    if (rails & (1 << i)){
+      if (_rail_users[i] == 0){
+        rail_write(i, true);
+        _rail_on_millis[i] = millis();
+      }
+      _rail_users[i]++;
+    }
+  }
+}
+
+bool ALog::rails_warm(uint8_t rails, uint16_t warmup_ms){
+  // True once every rail in "rails" has been on for at least warmup_ms
+  for (uint8_t i=0; i<N_RAILS; i++){
+    if ((rails & (1 << i)) && (millis() - _rail_on_millis[i]) < warmup_ms){
+      return false;
+    }
+  }
+  return true;
+}
+
+void ALog::rail_write(uint8_t rail_index, bool on){
+  // Pins and polarity of each rail; rails without a pin are skipped
+  if (rail_index == 0){
+    ALOG_PIN_WRITE(SensorPowerPin, on);
+    ALOG_PIN_WRITE(EXT_3V3, on != BOARD.EXT_3V3_active_low);
+  }
+  else if (rail_index == 1){
+    ALOG_PIN_WRITE(EXT_5V0, on);
+  }
+  else {
+    ALOG_PIN_WRITE(REF_1V8, on);
   }
 }
 
@@ -1617,17 +2826,16 @@ void ALog::record(int integer, String header, int base){
 
   if (first_log_after_booting_up){
     headerfile.print(header);
-    headerfile.print(",");
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(integer, base);
-  datafile.print(",");
-
-  // Echo to serial
-  Serial.print(integer, base);
-  Serial.print(",");
+  if (base == DEC){
+    write_value(integer, 0);
+  }
+  else {
+    write_text(String(integer, base));
+  }
 
 }
 
@@ -1684,17 +2892,11 @@ void ALog::record(float floatingpoint, String header){
 
   if (first_log_after_booting_up){
     headerfile.print(header);
-    headerfile.print(",");
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(floatingpoint);
-  datafile.print(",");
-
-  // Echo to serial
-  Serial.print(floatingpoint);
-  Serial.print(",");
+  write_value(floatingpoint, 2);
 
 }
 
@@ -1725,20 +2927,110 @@ void ALog::record(String _string, String header){
 
   if (first_log_after_booting_up){
     headerfile.print(header);
-    headerfile.print(",");
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(_string);
-  datafile.print(",");
+  write_text(_string);
 
-  // Echo to serial
-  Serial.print(_string);
-  Serial.print(",");
+}
+
+void ALog::record(int integer, const __FlashStringHelper* header, int base){
+
+  /**
+   * @brief
+   * Write user data to the SD card and display on serial monitor, with a
+   * header label stored in flash memory.
+   *
+   * @details
+   * Same as the other record() functions, but the header is given with
+   * F("..."), so that it is kept in flash rather than copied into RAM.
+   * This is recommended on the ALog BottleLogger, which has only 2 KB RAM.
+   *
+   * Example:
+   * ```
+   * alog.record(16, F("wind reading"), HEX);
+   * ```
+   *
+  */
+
+  header_label(header);
+
+  if (base == DEC){
+    write_value(integer, 0);
+  }
+  else {
+    write_text(String(integer, base));
+  }
+
+}
+
+void ALog::record(int integer, const __FlashStringHelper* header){
+
+  /**
+   * @brief
+   * Record an integer (base 10), with a header label stored in flash memory.
+   *
+   * Example:
+   * ```
+   * alog.record(16, F("wind reading"));
+   * ```
+   *
+  */
+
+  record(integer, header, DEC);
 
 }
 
+void ALog::record(float floatingpoint, const __FlashStringHelper* header){
+
+  /**
+   * @brief
+   * Record a floating-point number, with a header label stored in flash
+   * memory.
+   *
+   * Example:
+   * ```
+   * alog.record(2.06, F("wind reading"));
+   * ```
+   *
+  */
+
+  header_label(header);
+
+  write_value(floatingpoint, 2);
+
+}
+
+void ALog::record(String _string, const __FlashStringHelper* header){
+
+  /**
+   * @brief
+   * Record a string, with a header label stored in flash memory.
+   *
+   * Example:
+   * ```
+   * alog.record("windy", F("wind reading"));
+   * ```
+   *
+  */
+
+  header_label(header);
+
+  write_text(_string);
+
+}
+
+void ALog::header_label(const __FlashStringHelper* label){
+  // Column label, streamed from flash to header.txt on the first log after
+  // booting up
+  if (first_log_after_booting_up){
+    headerfile.print(label);
+    headerfile.print(F(","));
+    headerfile.sync();
+  }
+}
+
 // Read analog pin
 //////////////////////////////
 
@@ -1768,19 +3060,13 @@ float ALog::readPin(uint8_t pin){
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Analog pin ");
+    headerfile.print(F("Analog pin "));
     headerfile.print(pin);
-    headerfile.print(",");
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(pinValue);
-  datafile.print(",");
-
-  // Echo to serial
-  Serial.print(pinValue);
-  Serial.print(",");
+  write_value(pinValue, 2);
 
   return pinValue;
 
@@ -1815,13 +3101,7 @@ void ALog::readPins(){
   ///////////////
 
 
-  // SD write
-  datafile.print(pinValue);
-  datafile.print(",");
-
-  // Echo to serial
-  Serial.print(pinValue);
-  Serial.print(",");
+  write_value(pinValue, 0);
 
     if(i==3){
       i=i+2;
@@ -1873,19 +3153,13 @@ float ALog::readPinOversample(uint8_t pin, uint8_t bits){
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Analog pin ");
+    headerfile.print(F("Analog pin "));
     headerfile.print(pin);
-    headerfile.print(",");
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(pinValue,1);
-  datafile.print(",");
-
-  // Echo to serial
-  Serial.print(pinValue,1);
-  Serial.print(",");
+  write_value(pinValue, 1);
 
   return pinValue;
 
@@ -1959,13 +3233,29 @@ float ALog::thermistorB(float R0, float B, float Rref, float T0degC, \
   float Rtherm = _vdivR(thermPin, Rref, ADC_resolution_nbits, \
                         Rref_on_GND_side, oversample_debug);
 
-  // B-value thermistor equations
-  float T0 = T0degC + 273.15;
-  float Rinf = R0*exp(-B/T0);
-  float T = B / log(Rtherm/Rinf);
+  return thermistorB_temperature(Rtherm, R0, B, T0degC, record_results);
+
+}
+
+float ALog::thermistorB_temperature(float Rtherm, float R0, float B, \
+            float T0degC, bool record_results){
+  // Temperature from thermistor resistance, shared by thermistorB() and
+  // thermistorB_LTC2495(). A resistance of -9999 (no data) is passed through.
+
+  float T;
+
+  if (Rtherm == -9999){
+    T = -9999;
+  }
+  else {
+    // B-value thermistor equations
+    float T0 = T0degC + 273.15;
+    float Rinf = R0*exp(-B/T0);
+    T = B / log(Rtherm/Rinf);
 
-  // Convert to celsius
-  T = T - 273.15;
+    // Convert to celsius
+    T = T - 273.15;
+  }
 
   ///////////////
   // SAVE DATA //
@@ -1974,18 +3264,12 @@ float ALog::thermistorB(float R0, float B, float Rref, float T0degC, \
   if(record_results){
 
     if (first_log_after_booting_up){
-      headerfile.print("Temperature [degC]");
-      headerfile.print(",");
+      headerfile.print(F("Temperature [degC]"));
+      headerfile.print(F(","));
       headerfile.sync();
     }
 
-    // SD write
-    datafile.print(T, 4);
-    datafile.print(F(","));
-
-    // Echo to serial
-    Serial.print(T, 4);
-    Serial.print(F(","));
+    write_value(T, 4);
   }
 
   return T;
@@ -2067,24 +3351,15 @@ void ALog::HTM2500LF_humidity_temperature(uint8_t humidPin, uint8_t thermPin, \
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Relative humidity [%]");
-    headerfile.print(",");
-    headerfile.print("Temperature [degC]");
-    headerfile.print(",");
+    headerfile.print(F("Relative humidity [%]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Temperature [degC]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(RH, 4);
-  datafile.print(F(","));
-  datafile.print(Ttyp, 2);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(RH, 4);
-  Serial.print(F(","));
-  datafile.print(Ttyp, 2);
-  datafile.print(F(","));
+  write_value(RH, 4);
+  write_value(Ttyp, 2);
 
 }
 
@@ -2169,26 +3444,402 @@ void ALog::HM1500LF_humidity_with_external_temperature(uint8_t humidPin, \
   if (first_log_after_booting_up){
     // headerfile.print("Relative humidity sensor voltage output [V]");
     // headerfile.print(",");
-    headerfile.print("Relative humidity [%]");
-    headerfile.print(",");
+    headerfile.print(F("Relative humidity [%]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
   // SD write
   //datafile.print(V_humid_norm);
   //datafile.print(F(","));
-  datafile.print(RH, 4);
-  datafile.print(F(","));
+  write_value(RH, 4);
 
   // Echo to serial
   //Serial.print(V_humid_norm);
   //Serial.print(F(","));
-  Serial.print(RH, 4);
-  Serial.print(F(","));
 
 }
 
 
+// Overlapped sensor reading: cooperative scheduler
+/////////////////////////////////////////////////////
+
+// Each scheduled sensor is read in steps -- start, poll (returns true when
+// done), finish (record) -- so that one sensor's waits (conversion times,
+// ping spacing) are used to run the others. Only small parameter records
+// are kept between logging events; the working state of the ultrasonic
+// bursts is allocated by run_scheduled_sensors(), one per burst, for as
+// long as it runs.
+
+void ALog::schedule_sensor(uint8_t type, uint8_t pin, uint8_t Ex, \
+                           uint8_t n){
+  if (_n_scheduled_sensors >= ALOG_MAX_SCHEDULED_SENSORS){
+    Serial.println(F("Too many scheduled sensors; ignoring this one"));
+    return;
+  }
+  ALogScheduledSensor &sensor = _scheduled_sensors[_n_scheduled_sensors++];
+  sensor.type = type;
+  sensor.pin = pin;
+  sensor.Ex = Ex;
+  sensor.n = n;
+  sensor.rails = 0;
+  sensor.warmup_ms = 0;
+}
+
+void ALog::set_scheduled_sensor_power(uint8_t rails, uint16_t warmup_ms){
+  /**
+   * @brief Give the power rails and warm-up time of the sensor just
+   * scheduled.
+   *
+   * @details
+   * run_scheduled_sensors() turns on all rails needed by the scheduled
+   * sensors together, starts each sensor as soon as its own warm-up time
+   * has passed, and switches each rail off as soon as the last sensor on it
+   * has finished measuring (before the results are written to the SD card).
+   * See rail_on() for the rails.
+   *
+   * Example:
+   * ```
+   * alog.schedule_maxbotixHRXL_WR_analog(10, A0, 99);
+   * alog.set_scheduled_sensor_power(RAIL_5V0, 160);
+   * ```
+   */
+  if (_n_scheduled_sensors > 0){
+    _scheduled_sensors[_n_scheduled_sensors-1].rails = rails;
+    _scheduled_sensors[_n_scheduled_sensors-1].warmup_ms = warmup_ms;
+  }
+}
+
+void ALog::schedule_Barometer_BMP180(){
+  /**
+   * @brief Read the BMP180 barometer in run_scheduled_sensors().
+   *
+   * @details
+   * Records the same column as Barometer_BMP180(); its conversions overlap
+   * with the other scheduled sensors.
+   *
+   * Example:
+   * ```
+   * alog.schedule_Barometer_BMP180();
+   * ```
+   */
+  schedule_sensor(ALOG_TASK_BMP180, 0, 0, 0);
+}
+
+void ALog::schedule_maxbotixHRXL_WR_analog(uint8_t nping, uint8_t sonicPin, \
+                                           uint8_t EX){
+  /**
+   * @brief Read a 1-mm MaxBotix rangefinder in run_scheduled_sensors().
+   *
+   * @details
+   * Records the same columns as maxbotixHRXL_WR_analog() with
+   * writeAll = false. Other scheduled sensors run in the 100 ms between
+   * pings. Sensors that share an excitation pin or face the same surface
+   * may hear each other's pings: schedule only one of these.
+   *
+   * Example:
+   * ```
+   * alog.schedule_maxbotixHRXL_WR_analog(10, A0, 99);
+   * ```
+   */
+  schedule_sensor(ALOG_TASK_MAXBOTIX_HRXL_ANALOG, sonicPin, EX, nping);
+}
+
+void ALog::schedule_ultrasonicMB_analog_1cm(uint8_t nping, uint8_t Ex, \
+                                            uint8_t sonicPin){
+  /**
+   * @brief Read a 1-cm MaxBotix rangefinder in run_scheduled_sensors().
+   *
+   * @details
+   * Records the same columns as ultrasonicMB_analog_1cm() with
+   * writeAll = false. Other scheduled sensors run in the 100 ms between
+   * pings.
+   *
+   * Example:
+   * ```
+   * alog.schedule_ultrasonicMB_analog_1cm(10, 99, A1);
+   * ```
+   */
+  schedule_sensor(ALOG_TASK_MAXBOTIX_1CM_ANALOG, sonicPin, Ex, nping);
+}
+
+void ALog::run_scheduled_sensors(){
+  /**
+   * @brief Read all scheduled sensors at once and record their results.
+   *
+   * @details
+   * Starts every sensor registered with the schedule_... functions, keeps
+   * each one moving while the others wait, and then records their results
+   * in the order in which they were scheduled. The scheduled sensors take
+   * about as long as the slowest of them, rather than the sum of all of
+   * them. Only the BMP180 and the analog MaxBotix rangefinders can be
+   * scheduled; other sensors (serial, Decagon, SDI-12, ...) still run one
+   * after another, before or after this.
+   *
+   * Call this between startLogging() and endLogging(), where the columns
+   * should appear. If it is not called, endLogging() runs any scheduled
+   * sensors before ending the line. The list of scheduled sensors is then
+   * cleared, so schedule them again on each logging event.
+   *
+   * Example:
+   * ```
+   * alog.startLogging();
+   * alog.schedule_Barometer_BMP180();
+   * alog.schedule_maxbotixHRXL_WR_analog(10, A0, 99);
+   * alog.run_scheduled_sensors(); // ~1 s total, not ~1 s + BMP180 time
+   * alog.thermistorB(10000, 3950, 30000, 25, 2);
+   * alog.endLogging();
+   * ```
+   */
+  // Each sensor waits for its rails to warm up, runs, and is then done
+  uint8_t state[ALOG_MAX_SCHEDULED_SENSORS];
+  const uint8_t WARMING_UP = 0;
+  const uint8_t RUNNING = 1;
+  const uint8_t DONE = 2;
+  bool all_done;
+  uint8_t i;
+  uint8_t j; // Index of the ultrasonic burst, counted in the order scheduled
+
+  // Power up all of the rails needed at once: sensors sharing a rail warm up
+  // together
+  uint8_t n_bursts = 0;
+  for (i=0; i<_n_scheduled_sensors; i++){
+    rails_up(_scheduled_sensors[i].rails);
+    state[i] = WARMING_UP;
+    if (_scheduled_sensors[i].type != ALOG_TASK_BMP180){
+      n_bursts++;
+    }
+  }
+
+  // Working state (~90 bytes each) for the ultrasonic bursts only, on the
+  // heap rather than the stack. Without the RAM for it, each burst is read
+  // on its own, after the others, with the blocking functions.
+  ALogUltrasonicBurst *bursts = NULL;
+  if (n_bursts > 0){
+    bursts = new ALogUltrasonicBurst[n_bursts];
+    if (bursts == NULL){
+      Serial.println(F("No RAM to overlap ultrasonic bursts"));
+    }
+  }
+
+  // Start each sensor once warm, and poll until every one has finished
+  // measuring; release its rails as soon as it has
+  do {
+    all_done = true;
+    j = 0;
+    for (i=0; i<_n_scheduled_sensors; i++){
+      ALogScheduledSensor &sensor = _scheduled_sensors[i];
+      if (sensor.type == ALOG_TASK_BMP180){
+        if (state[i] == WARMING_UP && \
+            rails_warm(sensor.rails, sensor.warmup_ms)){
+          Barometer_BMP180_start();
+          state[i] = RUNNING;
+        }
+        else if (state[i] == RUNNING && Barometer_BMP180_poll()){
+          rail_off(sensor.rails);
+          state[i] = DONE;
+        }
+      }
+      else if (bursts == NULL){
+        // Read (and powered off) after the others; see below
+        state[i] = DONE;
+      }
+      else {
+        if (state[i] == WARMING_UP && \
+            rails_warm(sensor.rails, sensor.warmup_ms)){
+          ultrasonic_burst_start(sensor, bursts[j]);
+          state[i] = RUNNING;
+        }
+        else if (state[i] == RUNNING && \
+                 ultrasonic_burst_poll(sensor, bursts[j])){
+          rail_off(sensor.rails);
+          state[i] = DONE;
+        }
+        j++;
+      }
+      all_done &= (state[i] == DONE);
+    }
+  } while (!all_done);
+
+  // Finish: record in the order scheduled
+  j = 0;
+  for (i=0; i<_n_scheduled_sensors; i++){
+    ALogScheduledSensor &sensor = _scheduled_sensors[i];
+    if (sensor.type == ALOG_TASK_BMP180){
+      Barometer_BMP180();
+    }
+    else if (bursts == NULL){
+      // Wait out the warm-up, as the blocking functions do not
+      while (!rails_warm(sensor.rails, sensor.warmup_ms)){
+      }
+      if (sensor.type == ALOG_TASK_MAXBOTIX_HRXL_ANALOG){
+        maxbotixHRXL_WR_analog(sensor.n, sensor.pin, sensor.Ex, false);
+      }
+      else {
+        ultrasonicMB_analog_1cm(sensor.n, sensor.Ex, sensor.pin, false);
+      }
+      rail_off(sensor.rails);
+    }
+    else {
+      record_ultrasonic(ultrasonic_estimate(bursts[j].recent_ranges, \
+                        bursts[j].range_stats), bursts[j].range_stats, \
+                        (sensor.type == ALOG_TASK_MAXBOTIX_HRXL_ANALOG) ? \
+                        "mm" : "cm");
+      j++;
+    }
+  }
+  delete[] bursts;
+  _n_scheduled_sensors = 0;
+}
+
+void ALog::ultrasonic_burst_start(ALogScheduledSensor &sensor, \
+                                  ALogUltrasonicBurst &burst){
+  // Same sequence as the blocking functions: 2 excitations to clear out
+  // junk, then excite, wait 100 ms, and read, for each ping
+  burst.range_stats.reset();
+  burst.npulses = 0;
+  ultrasonic_burst_excite(sensor, burst);
+}
+
+void ALog::ultrasonic_burst_excite(ALogScheduledSensor &sensor, \
+                                   ALogUltrasonicBurst &burst){
+  if (sensor.Ex != 99){
+    excitation_pulse(sensor.Ex, 1000);
+  }
+  burst.npulses++;
+  burst.next_millis = millis() + 100;
+}
+
+bool ALog::ultrasonic_burst_poll(ALogScheduledSensor &sensor, \
+                                 ALogUltrasonicBurst &burst){
+  if ((long)(millis() - burst.next_millis) < 0){
+    return false;
+  }
+  // Past the 2 junk pulses: read this ping
+  if (burst.npulses > 2){
+    float range;
+    float mm_per_unit;
+    if (sensor.type == ALOG_TASK_MAXBOTIX_HRXL_ANALOG){
+      range = (analogRead(sensor.pin) + 1) * 5; // 10-bit ADC (1--1024)*5 = mm
+      mm_per_unit = 1.;
+    }
+    else {
+      range = analogRead(sensor.pin); // 10-bit ADC value = range in cm
+      mm_per_unit = 10.;
+    }
+    _ultrasonicAddPing(range, burst.recent_ranges, burst.range_stats);
+    if (burst.range_stats.count() >= sensor.n || \
+        ultrasonic_burst_converged(burst.range_stats, mm_per_unit)){
+      return true;
+    }
+  }
+  ultrasonic_burst_excite(sensor, burst);
+  return false;
+}
+
+
+// Line buffer for data
+/////////////////////////
+
+ALogLineBuffer::ALogLineBuffer(){
+  _text = NULL;
+  _size = 0;
+  _length = 0;
+  _line_length = 0;
+  _longest_line = 0;
+  _overflowed = false;
+  _file = NULL;
+}
+
+bool ALogLineBuffer::set_length(uint16_t length){
+  // Allocated once, before logging starts; false if there is not the RAM
+  delete[] _text;
+  _text = new char[length];
+  _size = (_text == NULL) ? 0 : length;
+  return (_text != NULL);
+}
+
+void ALogLineBuffer::begin(Print *file){
+  // Start a line, to be written to file (if not NULL) and to serial
+  if (_text == NULL){
+    set_length(ALOG_LINE_BUFFER_LENGTH);
+  }
+  _length = 0;
+  _line_length = 0;
+  _file = file;
+}
+
+size_t ALogLineBuffer::write(uint8_t c){
+  return write(&c, 1);
+}
+
+size_t ALogLineBuffer::write(const uint8_t *buffer, size_t size){
+  // Two characters are kept free for the line end. Without a buffer (no
+  // RAM), everything is written straight through.
+  size_t remaining = size;
+  _line_length += size;
+  while (remaining > 0){
+    if (_length + 2 >= _size){
+      drain();
+      if (_size < 3){
+        if (_file){
+          _file->write(buffer, remaining);
+        }
+        Serial.write(buffer, remaining);
+        return size;
+      }
+      if (!_overflowed){
+        _overflowed = true;
+        Serial.println();
+        Serial.println(F("Data line longer than its buffer: written in \
+pieces; see set_line_buffer_length()"));
+      }
+    }
+    uint16_t n = min(remaining, (size_t)(_size - 2 - _length));
+    memcpy(_text + _length, buffer, n);
+    _length += n;
+    buffer += n;
+    remaining -= n;
+  }
+  return size;
+}
+
+void ALogLineBuffer::commit(){
+  if (_size < 2){
+    drain();
+    if (_file){
+      _file->print(F("\r\n"));
+    }
+    Serial.print(F("\r\n"));
+  }
+  else {
+    _text[_length++] = '\r';
+    _text[_length++] = '\n';
+    drain();
+  }
+  _line_length += 2;
+  _longest_line = max(_longest_line, _line_length);
+}
+
+bool ALogLineBuffer::overflowed(){
+  return _overflowed;
+}
+
+uint16_t ALogLineBuffer::longest_line(){
+  return _longest_line;
+}
+
+void ALogLineBuffer::drain(){
+  if (_length == 0){
+    return;
+  }
+  if (_file){
+    _file->write((const uint8_t*)_text, _length);
+  }
+  Serial.write((const uint8_t*)_text, _length);
+  _length = 0;
+}
+
 // MaxBotix ruggedized standard size ultrasonic rangefinder:
 // 1 cm = 1 10-bit ADC interval
 //////////////////////////////////////////////////////////////
@@ -2235,9 +3886,10 @@ void ALog::ultrasonicMB_analog_1cm(uint8_t nping, uint8_t Ex, uint8_t sonicPin,
   */
 
   float range; // The most recent returned range
-  float ranges[nping]; // Array of returned ranges
-  float sumRange = 0; // The sum of the ranges measured
-  float meanRange; // The average range over all the pings
+  ALogStats range_stats; // Running mean and standard deviation of the ranges
+  // Most recent pings, for the robust estimators
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+  float meanRange; // The estimated range over all the pings
 
 //  Serial.println();
   // Get range measurements
@@ -2246,49 +3898,44 @@ void ALog::ultrasonicMB_analog_1cm(uint8_t nping, uint8_t Ex, uint8_t sonicPin,
   Serial.flush();
   for (int i=1; i<=2; i++){
     if(Ex != 99){
-      digitalWrite(Ex,HIGH);
-        delay(1);
-      digitalWrite(Ex,LOW);
+      excitation_pulse(Ex, 1000);
       }
     delay(100);
     }
   for(int i=1;i<=nping;i++){
     if(Ex != 99){
-      digitalWrite(Ex,HIGH);
-        delay(1);
-      digitalWrite(Ex,LOW);
+      excitation_pulse(Ex, 1000);
       }
     delay(100);
-    range = analogRead(sonicPin);
-    ranges[i-1] = range; // 10-bit ADC value = range in cm
-                         // C is 0-indexed, hence the "-1"
+    range = analogRead(sonicPin); // 10-bit ADC value = range in cm
     if (writeAll){
       if (first_log_after_booting_up){
-        headerfile.print("Ultrasonic distance to surface [cm]");
-        headerfile.print(",");
+        headerfile.print(F("Ultrasonic distance to surface [cm]"));
+        headerfile.print(F(","));
         headerfile.sync();
       }
-      Serial.print(range);
-      Serial.print(F(","));
-      datafile.print(range);
-      datafile.print(F(","));
+      write_value(range, 2);
       //SDpowerOff();
     }
-  sumRange += range;
+  _ultrasonicAddPing(range, recent_ranges, range_stats);
+  if (ultrasonic_burst_converged(range_stats, 10.)){
+    break;
   }
-
-  // Find mean of range measurements from sumRange and nping
-  meanRange = sumRange/nping;
-
-  // Find standard deviation
-  float sumsquares = 0;
-  float sigma;
-  for(int i=0;i<nping;i++){
-    // Sum the squares of the differences from the mean
-    sumsquares += square(ranges[i]-meanRange);
   }
-  // Calculate stdev
-  sigma = sqrt(sumsquares/nping);
+  // Adaptive bursts may stop early: keep the per-ping columns aligned
+  if (writeAll){
+    for (int i=range_stats.count(); i<nping; i++){
+      if (first_log_after_booting_up){
+        headerfile.print(F("Ultrasonic distance to surface [cm]"));
+        headerfile.print(F(","));
+        headerfile.sync();
+      }
+      write_value(-9999, 0);
+    }
+  }
+
+  // Estimated range; standard deviation is recorded from range_stats
+  meanRange = ultrasonic_estimate(recent_ranges, range_stats);
 
   ///////////////
   // SAVE DATA //
@@ -2296,24 +3943,7 @@ void ALog::ultrasonicMB_analog_1cm(uint8_t nping, uint8_t Ex, uint8_t sonicPin,
 
   delay(10);
 
-  if (first_log_after_booting_up){
-    headerfile.print("Mean ultrasonic distance to surface [cm]");
-    headerfile.print(",");
-    headerfile.print("Standard deviation ultrasonic distance to surface [cm]");
-    headerfile.print(",");
-    headerfile.sync();
-  }
-
-  datafile.print(meanRange);
-  datafile.print(F(","));
-  datafile.print(sigma);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(meanRange);
-  Serial.print(F(","));
-  Serial.print(sigma);
-  Serial.print(F(","));
+  record_ultrasonic(meanRange, range_stats, "cm");
 
 }
 
@@ -2364,9 +3994,10 @@ void ALog::maxbotixHRXL_WR_analog(uint8_t nping, uint8_t sonicPin, uint8_t EX, \
   */
 
   float range; // The most recent returned range
-  float ranges[nping]; // Array of returned ranges
-  float sumRange = 0; // The sum of the ranges measured
-  float meanRange; // The average range over all the pings
+  ALogStats range_stats; // Running mean and standard deviation of the ranges
+  // Most recent pings, for the robust estimators
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+  float meanRange; // The estimated range over all the pings
   int sp; // analog reading of sonic pin; probably unnecessary, but Arduino warns against having too many fcns w/ artihmetic, I think
 
   // Get range measurements
@@ -2376,74 +4007,52 @@ void ALog::maxbotixHRXL_WR_analog(uint8_t nping, uint8_t sonicPin, uint8_t EX, \
 
   for (int i=1; i<=2; i++){
     if(EX != 99){
-      digitalWrite(EX,HIGH);
-        delay(1);
-      digitalWrite(EX,LOW);
+      excitation_pulse(EX, 1000);
       }
     delay(100);
     }
   sp = analogRead(sonicPin);
   for(int i=1;i<=nping;i++){
     if(EX != 99){
-      digitalWrite(EX,HIGH);
-        delay(1);
-      digitalWrite(EX,LOW);
+      excitation_pulse(EX, 1000);
       }
     delay(100);
     sp = analogRead(sonicPin);
-    range = (sp + 1) * 5;
-    ranges[i-1] = range; // 10-bit ADC value (1--1024) * 5 = range in mm
-                         // C is 0-indexed, hence the "-1"
+    range = (sp + 1) * 5; // 10-bit ADC value (1--1024) * 5 = range in mm
     if (writeAll){
       if (first_log_after_booting_up){
-        headerfile.print("Ultrasonic distance to surface [mm]");
-        headerfile.print(",");
+        headerfile.print(F("Ultrasonic distance to surface [mm]"));
+        headerfile.print(F(","));
         headerfile.sync();
       }
-      Serial.print(range, 0);
-      Serial.print(F(","));
-      datafile.print(range, 0);
-      datafile.print(F(","));
+      write_value(range, 0);
       //SDpowerOff();
     }
-  sumRange += range;
+  _ultrasonicAddPing(range, recent_ranges, range_stats);
+  if (ultrasonic_burst_converged(range_stats, 1.)){
+    break;
   }
-
-  // Find mean of range measurements from sumRange and nping
-  meanRange = sumRange/nping;
-
-  // Find standard deviation
-  float sumsquares = 0;
-  float sigma;
-  for(int i=0;i<nping;i++){
-    // Sum the squares of the differences from the mean
-    sumsquares += square(ranges[i]-meanRange);
   }
-  // Calculate stdev
-  sigma = sqrt(sumsquares/nping);
+  // Adaptive bursts may stop early: keep the per-ping columns aligned
+  if (writeAll){
+    for (int i=range_stats.count(); i<nping; i++){
+      if (first_log_after_booting_up){
+        headerfile.print(F("Ultrasonic distance to surface [mm]"));
+        headerfile.print(F(","));
+        headerfile.sync();
+      }
+      write_value(-9999, 0);
+    }
+  }
+
+  // Estimated range; standard deviation is recorded from range_stats
+  meanRange = ultrasonic_estimate(recent_ranges, range_stats);
 
   ///////////////
   // SAVE DATA //
   ///////////////
 
-  if (first_log_after_booting_up){
-    headerfile.print("Mean ultrasonic distance to surface [mm]");
-    headerfile.print(",");
-    headerfile.print("Standard deviation ultrasonic distance to surface [mm]");
-    headerfile.print(",");
-    headerfile.sync();
-  }
-
-  datafile.print(meanRange);
-  datafile.print(F(","));
-  datafile.print(sigma);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(meanRange);
-  Serial.print(F(","));
-  Serial.print(sigma);
-  Serial.print(F(","));
+  record_ultrasonic(meanRange, range_stats, "mm");
 
 }
 
@@ -2458,6 +4067,11 @@ float ALog::maxbotixHRXL_WR_Serial(uint8_t Ex, uint8_t npings, bool writeAll, \
    * LIKELY THAT THE ISSUE IS NOW SOLVED, MORE TESTING IS REQUIRED.
    * (ADW, 26 NOVEMBER 2016) (maybe solved w/ HW Serial?)
    *
+   * The Serial port is switched to 9600 bps once for the whole burst, so
+   * nothing should be sent to the computer until this function returns.
+   * A ping that does not return a complete range within 250 ms (e.g., if the
+   * sensor is not connected) is recorded as 0 and counted as a nodata return.
+   *
    * @param Ex Excitation pin that turns the sensor on; if this is not needed (i.e.
    * you are turning main power off and on instead), then just set this to a
    * value that is not a pin, and ensure that you turn the power to the sensor
@@ -2467,7 +4081,8 @@ float ALog::maxbotixHRXL_WR_Serial(uint8_t Ex, uint8_t npings, bool writeAll, \
    * includes ten short readings that the sensor internally processes
    *
    * @param writeAll will write each reading of the sensor (each ping)
-   * to the serial monitor and SD card.
+   * to the SD card. They reach the serial monitor with the rest of the
+   * line, after the sensor has finished talking.
    *
    * @param maxRange The range (in mm) at which the logger maxes out; this will
    * be remembered to check for errors and to become a nodata values
@@ -2487,150 +4102,211 @@ float ALog::maxbotixHRXL_WR_Serial(uint8_t Ex, uint8_t npings, bool writeAll, \
    * ```
    */
 
-  // Stores the ranging output from the MaxBotix sensor
-  int myranges[npings]; // Declare an array to store the ranges [mm] // Should be int, but float for passing to fcns
   // Get nodata value - 5000 or 9999 based on logger max range (in meters)
   // I have also made 0 a nodata value, because it appears sometimes and shouldn't
   // (minimum range = 300 mm)
-  int nodata_value;
-  if (maxRange == 5){
+  // (maxRange may be given in meters or in mm)
+  int nodata_value = 9999;
+  if (maxRange == 5 || maxRange == 5000){
     nodata_value = 5000;
   }
-  else if (maxRange == 10){
-    nodata_value = 9999;
-  }
-  // Put all of the range values in the array
+  // Running statistics of the good returns: no per-ping arrays
+  ALogStats range_stats;
+  // Most recent good returns, for the robust estimators
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+  int range; // The most recent returned range [mm]
+  // Switch the UART from 38400 bps computer comms to the sensor's 9600 bps
+  // once for the whole burst, rather than once per ping
+  Serial.flush();
+  Serial.end();
+  Serial.begin(9600);
   for (int i=0; i<npings; i++){
     // Must add int Rx to use this; currently, don't trust SoftwareSerial
-    // myranges[i] = maxbotix_soft_Serial_parse(Ex, Rx, RS232);
-    myranges[i] = maxbotix_Serial_parse(Ex);
-  }
-  // Then get the mean and standard deviation of all of the data
-  int npings_with_nodata_returns = 0;
-  unsigned long sum_of_good_ranges = 0;
-  int good_ranges[npings];
-  int j=0;
-  for (int i=0; i<npings; i++){
-    if (myranges[i] != nodata_value && myranges[i] != 0){
-      sum_of_good_ranges += myranges[i];
-      good_ranges[j] = myranges[i];
-      j++;
+    // range = maxbotix_soft_Serial_parse(Ex, Rx, RS232);
+    range = maxbotix_Serial_parse(Ex);
+    if (range != nodata_value && range != 0){
+      _ultrasonicAddPing(range, recent_ranges, range_stats);
     }
-    else{
-      npings_with_nodata_returns ++;
+    // Write all values if so desired. The line is written to serial once
+    // it is done, after the Serial port has finished talking to the sensor.
+    if (writeAll){
+      if (first_log_after_booting_up){
+        headerfile.print(F("Ultrasonic distance to surface [mm]"));
+        headerfile.print(F(","));
+        headerfile.sync();
+      }
+      write_value(range, 0);
     }
   }
-  float npings_with_real_returns = npings - npings_with_nodata_returns;
+  Serial.end();
+  Serial.begin(38400);
+  // Then get the mean and standard deviation of all of the data
+  float npings_with_real_returns = range_stats.count();
   float mean_range;
   float standard_deviation;
   // Avoid div0 errors
   if (npings_with_real_returns > 0){
-    mean_range = sum_of_good_ranges / npings_with_real_returns;
-    standard_deviation = standard_deviation_from_array(good_ranges, npings_with_real_returns, mean_range);
+    mean_range = ultrasonic_estimate(recent_ranges, range_stats);
+    standard_deviation = range_stats.standard_deviation();
   }
   else {
     mean_range = -9999;
     standard_deviation = -9999;
   }
-  // Write all values if so desired
-  if (writeAll){
-    for (int i=0; i<npings; i++){
-      if (first_log_after_booting_up){
-        headerfile.print("Ultrasonic distance to surface [mm]");
-        headerfile.print(",");
-        headerfile.sync();
-      }
-      datafile.print(myranges[i]);
-      datafile.print(F(","));
-      // Echo to serial
-      Serial.print(myranges[i]);
-      Serial.print(F(","));
-    }
-
-  }
 
   ///////////////
   // SAVE DATA //
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Mean ultrasonic distance to surface [mm]");
-    headerfile.print(",");
-    headerfile.print("Standard deviation ultrasonic distance to surface [mm]");
-    headerfile.print(",");
-    headerfile.print("Number of readings with non-error returns");
-    headerfile.print(",");
+    ultrasonic_estimate_header("mm");
+    headerfile.print(F("Standard deviation ultrasonic distance to surface [mm]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Number of readings with non-error returns"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
   // Always write the mean, standard deviation, and number of good returns
-  datafile.print(mean_range);
-  datafile.print(F(","));
-  datafile.print(standard_deviation);
-  datafile.print(F(","));
-  datafile.print(npings_with_real_returns);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(mean_range);
-  Serial.print(F(","));
-  Serial.print(standard_deviation);
-  Serial.print(F(","));
-  Serial.print(npings_with_real_returns);
-  Serial.print(F(","));
+  write_value(mean_range, 2);
+  write_value(standard_deviation, 2);
+  write_value(npings_with_real_returns, 2);
 
   // return mean range for functions that need it, e.g., to trigger camera
   return mean_range;
 }
 
-float ALog::standard_deviation_from_array(float values[], int nvalues,
-            float mean){
-  float sumsquares = 0;
-  for (int i=0; i<nvalues; i++){
-    sumsquares += square(values[i] - mean);
+void ALog::excitation_pulse(uint8_t pin, uint16_t microseconds){
+  // HIGH pulse to trigger a sensor reading. The pin's port and bit are
+  // looked up once, before the pulse. Interrupts are held off only for
+  // each read-modify-write of the port, so that an interrupt that writes
+  // the same port cannot undo it; during the pulse they stay on, so that
+  // serial bytes and wind and rain counts are not lost. An interrupt may
+  // lengthen the pulse by its own running time (a few microseconds).
+  uint8_t port_number = digitalPinToPort(pin);
+  if (port_number == NOT_A_PIN){
+    return;
+  }
+  volatile uint8_t* port = portOutputRegister(port_number);
+  uint8_t mask = digitalPinToBitMask(pin);
+  uint8_t oldSREG = SREG;
+  cli();
+  *port |= mask;
+  SREG = oldSREG;
+  delayMicroseconds(microseconds);
+  oldSREG = SREG;
+  cli();
+  *port &= ~mask;
+  SREG = oldSREG;
+}
+
+float ALog::ultrasonic_estimate(float recent_ranges[], ALogStats &range_stats){
+  // Distance from a burst of pings, using the estimator chosen with
+  // set_ultrasonic_estimator(); see _ultrasonicEstimate()
+  return _ultrasonicEstimate(_ultrasonic_estimator, recent_ranges, range_stats);
+}
+
+void ALog::record_ultrasonic(float estimated_range, ALogStats &range_stats, \
+                             const char* units){
+  // Estimated distance, standard deviation, and (for adaptive bursts) the
+  // number of pings used
+  float sigma = range_stats.standard_deviation();
+  if (first_log_after_booting_up){
+    ultrasonic_estimate_header(units);
+    headerfile.print(F("Standard deviation ultrasonic distance to surface ["));
+    headerfile.print(units);
+    headerfile.print(F("],"));
+    if (_ultrasonic_target_standard_error_mm > 0){
+      headerfile.print(F("Number of pings used"));
+      headerfile.print(F(","));
+    }
+    headerfile.sync();
+  }
+
+  write_value(estimated_range, 2);
+  write_value(sigma, 2);
+
+  if (_ultrasonic_target_standard_error_mm > 0){
+    write_value(range_stats.count(), 0);
   }
-  return sqrt(sumsquares/nvalues);
 }
 
-float ALog::standard_deviation_from_array(int values[], int nvalues,
-            float mean){
-  float sumsquares = 0;
-  for (int i=0; i<nvalues; i++){
-    sumsquares += square(values[i] - mean);
+bool ALog::ultrasonic_burst_converged(ALogStats &range_stats, \
+                                      float mm_per_unit){
+  // True if adaptive bursts are enabled (set_ultrasonic_adaptive) and the
+  // burst has converged; see _ultrasonicConverged()
+  return _ultrasonicConverged(range_stats, mm_per_unit, \
+                              _ultrasonic_target_standard_error_mm, \
+                              _ultrasonic_min_pings);
+}
+
+void ALog::ultrasonic_estimate_header(const char* units){
+  // Header label for the estimated distance; names the estimator
+  if (_ultrasonic_estimator == ULTRASONIC_MEDIAN){
+    headerfile.print(F("Median"));
+  }
+  else if (_ultrasonic_estimator == ULTRASONIC_TRIMMED_MEAN){
+    headerfile.print(F("Trimmed mean"));
   }
-  return sqrt(sumsquares/nvalues);
+  else if (_ultrasonic_estimator == ULTRASONIC_MAD_FILTERED_MEAN){
+    headerfile.print(F("MAD-filtered mean"));
+  }
+  else {
+    headerfile.print(F("Mean"));
+  }
+  headerfile.print(F(" ultrasonic distance to surface ["));
+  headerfile.print(units);
+  headerfile.print(F("],"));
 }
 
 int ALog::maxbotix_Serial_parse(uint8_t Ex){
-  // NOTE: Currently assumes only one Serial port.
-  // Excites the MaxBotix sensor and receives its ranging output
-  char range[7]; // R####<\r>, so R + 4 chars + carriage return + null
-  Serial.end(); // End 38400 bps computer comms
-  Serial.begin(9600); // Start 9600 bps logger comms
+  // NOTE: Currently assumes only one Serial port, already set to 9600 bps
+  // by the calling function.
+  // Excites the MaxBotix sensor and parses its ranging output, R####<\r>,
+  // one character at a time from the Serial receive buffer (which is filled
+  // by the UART interrupt).
+  // Returns 0 -- a nodata value -- if there is no complete return within
+  // 250 ms, rather than waiting for the watchdog timer to reset the logger
+  // if the sensor is missing.
+  int range = 0;
+  uint8_t ndigits = 0;
+  bool in_frame = false;
+  char c;
+  // Throw away anything left over from before this ping
+  while (Serial.available()){
+    Serial.read();
+  }
   //Excite the sensor to produce a pulse
-  pinMode(Ex, OUTPUT);
-  digitalWrite(Ex, HIGH);
-  delay(1);
-  digitalWrite(Ex, LOW);
+  if (Ex < NUM_DIGITAL_PINS){
+    pinMode(Ex, OUTPUT);
+    excitation_pulse(Ex, 1000);
+  }
 //  delay(150); //Chad, do I need a 150ms delay needed to make sure low at end of sample to get unfiltered readings?
   // Record the result of the ranging
-  int i=0; // counter
-  // Not sure if this will work - maybe loop around to the other end of the array?
-  while (range[i-1] != 13){
+  unsigned long millis_start = millis();
+  while (millis() - millis_start < 250){
     if (Serial.available()){
-      range[i] = Serial.read();
-      i++;
+      c = Serial.read();
+      if (c == 'R'){
+        // Start of a new return; discard any partial one
+        in_frame = true;
+        range = 0;
+        ndigits = 0;
+      }
+      else if (in_frame && c >= '0' && c <= '9' && ndigits < 4){
+        range = 10*range + (c - '0');
+        ndigits++;
+      }
+      else if (in_frame && c == 13 && ndigits == 4){
+        return range;
+      }
+      else {
+        // Garbled return; wait for the next "R"
+        in_frame = false;
+      }
     }
   }
-  Serial.end();
-  Serial.begin(38400);
-  // Convert to integer
-  char r2[4]; // range stripped of all of its extra characters
-  for (int i=1; i<5; i++){
-    r2[i-1] = range[i];
-  }
-  int r3 = atol(r2);
-  return r3;
+  return 0;
 }
 
 /*
@@ -2746,26 +4422,21 @@ void ALog::Inclinometer_SCA100T_D02_analog_Tcorr(uint8_t xPin, uint8_t yPin, \
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Inclinometer voltage (x-axis) [V]");
-    headerfile.print(",");
-    headerfile.print("Inclinometer voltage (y-axis) [V]");
-    headerfile.print(",");
-    headerfile.print("Inclinometer tilt (x-axis) [degrees]");
-    headerfile.print(",");
-    headerfile.print("Inclinometer tilt (y-axis) [degrees]");
-    headerfile.print(",");
+    headerfile.print(F("Inclinometer voltage (x-axis) [V]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Inclinometer voltage (y-axis) [V]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Inclinometer tilt (x-axis) [degrees]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Inclinometer tilt (y-axis) [degrees]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(Vout_x);
-  datafile.print(F(","));
-  datafile.print(Vout_y);
-  datafile.print(F(","));
-  datafile.print(angle_x_degrees);
-  datafile.print(F(","));
-  datafile.print(angle_y_degrees);
-  datafile.print(F(","));
+  write_value(Vout_x, 2);
+  write_value(Vout_y, 2);
+  write_value(angle_x_degrees, 2);
+  write_value(angle_y_degrees, 2);
 
   // Echo to serial
   //int a = analogRead(xPin) - 512;
@@ -2776,20 +4447,12 @@ void ALog::Inclinometer_SCA100T_D02_analog_Tcorr(uint8_t xPin, uint8_t yPin, \
   //Serial.print(F(","));
   //Serial.print(VDD);
   //Serial.print(F(","));
-  Serial.print(Vout_x);
-  Serial.print(F(","));
-  Serial.print(Vout_y);
-  Serial.print(F(","));
-  Serial.print(angle_x_degrees);
-  Serial.print(F(","));
-  Serial.print(angle_y_degrees);
-  Serial.print(F(","));
 
 }
 
 void ALog::Anemometer_reed_switch(uint8_t interrupt_pin_number, \
            unsigned long reading_duration_milliseconds, \
-           float meters_per_second_per_rotation){
+           float meters_per_second_per_rotation, bool record_gust){
   /**
    * @brief
    * Anemometer that flips a reed switch each time it spins.
@@ -2809,80 +4472,156 @@ void ALog::Anemometer_reed_switch(uint8_t interrupt_pin_number, \
    * (http://www.inspeed.com/anemometers/Vortex_Wind_Sensor.asp),
    * this is: <b>2.5 mph/Hz = 1.1176 (m/s)/Hz</b>
    *
+   * @param record_gust: If true, the reading is also broken into 1-second
+   * sub-windows, and the wind speed from the sub-window with the most
+   * rotations is written as the gust speed. Defaults to false.
+   *
    * @details
-   * This function depends on the global variable \b rotation_count.
+   * This function depends on the global variable \b rotation_count, which
+   * is incremented by an interrupt. Between rotations, the MCU sits in the
+   * "idle" sleep mode instead of spinning in a loop, so the reading costs
+   * little more power than the time that the sensor is powered.
    *
    * Example:
    * ```
    * // 4-second reading with Inspeed Vortex wind sensor on digital pin 3
    * // (interrupt 1), returned in meters per second
    * alog.Anemometer_reed_switch(3, 4000, 1.1176);
+   * // Same, but also record the strongest 1-second gust
+   * alog.Anemometer_reed_switch(3, 4000, 1.1176, true);
    * ```
    *
    */
 
-  // I plan for no more than 40 Hz (100 mph), so will have a delay of
-  // 10 ms between rotations to debounce the input. This should allow
-  // up to 250 mph, at which point larger problems likely exist...
+  // I plan for no more than 40 Hz (100 mph), so will ignore edges within
+  // 20 ms of a rotation to debounce the input. This should allow
+  // up to 50 Hz (125 mph), at which point larger problems likely exist...
 
   // Look up: http://arduino.stackexchange.com/questions/12587/how-can-i-handle-the-millis-rollover
 
-  rotation_count = 0; // Global variable
-  //int rotation_count_local;
+  uint16_t _rotation_count; // Copy of the global, read with interrupts off
+  uint16_t rotation_count_at_last_gust = 0;
+  uint16_t max_rotations_per_second = 0;
   float rotation_Hz;
   float wind_speed_meters_per_second;
+  float gust_meters_per_second;
   float reading_duration_seconds = reading_duration_milliseconds / 1000.;
 
   pinMode(interrupt_pin_number, INPUT);
   digitalWrite(interrupt_pin_number, HIGH);
 
+  rotation_count = 0; // Global variable
+  _anemometer_last_rotation_micros = micros();
   unsigned long millis_start = millis();
+  unsigned long millis_gust = millis_start;
   attachInterrupt(digitalPinToInterrupt(interrupt_pin_number), \
                   _anemometer_count_increment, FALLING);
 
   // Avoid rollovers by comparing unsigned integers with the
   // same number of bits
-  // Wait in while loop while interrupt can increment counter.
+  // Idle while the interrupt increments the counter: the CPU clock stops, but
+  // timer 0 (millis) and the external interrupt both still wake the MCU.
+  set_sleep_mode(SLEEP_MODE_IDLE);
   while (millis() - millis_start <= reading_duration_milliseconds){
+    sleep_mode();
+    if (record_gust && (millis() - millis_gust >= 1000)){
+      millis_gust += 1000;
+      noInterrupts();
+      _rotation_count = rotation_count;
+      interrupts();
+      if (_rotation_count - rotation_count_at_last_gust > \
+          max_rotations_per_second){
+        max_rotations_per_second = _rotation_count - \
+                                   rotation_count_at_last_gust;
+      }
+      rotation_count_at_last_gust = _rotation_count;
+    }
   }
-  Serial.print(""); // Well, this is weird, but required to work.
+  Serial.print(F("")); // Well, this is weird, but required to work.
   detachInterrupt(digitalPinToInterrupt(interrupt_pin_number));
+  _rotation_count = rotation_count;
 
-  rotation_Hz = rotation_count / reading_duration_seconds;
+  rotation_Hz = _rotation_count / reading_duration_seconds;
   wind_speed_meters_per_second = rotation_Hz * meters_per_second_per_rotation;
+  gust_meters_per_second = max_rotations_per_second * \
+                           meters_per_second_per_rotation;
 
   ///////////////
   // SAVE DATA //
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Number of anemometer rotations");
-    headerfile.print(",");
-    headerfile.print("Anemometer rotation frequency [Hz]");
-    headerfile.print(",");
-    headerfile.print("Wind speed [m/s]");
-    headerfile.print(",");
+    headerfile.print(F("Number of anemometer rotations"));
+    headerfile.print(F(","));
+    headerfile.print(F("Anemometer rotation frequency [Hz]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Wind speed [m/s]"));
+    headerfile.print(F(","));
+    if (record_gust){
+      headerfile.print(F("Gust wind speed (max 1-s mean) [m/s]"));
+      headerfile.print(F(","));
+    }
     headerfile.sync();
   }
   // Note: should estimate error based on +/- 1 rotation (depending on whether
   // just starting or just ending at the measurement start time)
 
-  // SD write
-  datafile.print(rotation_count);
-  datafile.print(F(","));
-  datafile.print(rotation_Hz, 4);
-  datafile.print(F(","));
-  datafile.print(wind_speed_meters_per_second, 4);
-  datafile.print(F(","));
+  write_value(_rotation_count, 0);
+  write_value(rotation_Hz, 4);
+  write_value(wind_speed_meters_per_second, 4);
+  if (record_gust){
+    write_value(gust_meters_per_second, 4);
+  }
 
-  // Echo to serial
-  Serial.print(rotation_count);
-  Serial.print(F(","));
-  Serial.print(rotation_Hz, 4);
-  Serial.print(F(","));
-  Serial.print(wind_speed_meters_per_second, 4);
-  Serial.print(F(","));
+}
 
+void ALog::Anemometer_reed_switch_accumulate(uint8_t interrupt_pin_number, \
+           float meters_per_second_per_rotation){
+  /**
+   * @brief
+   * Count anemometer rotations in the background, across the whole time
+   * that the logger sleeps.
+   *
+   * @param interrupt_pin_number is the digital pin number corresponding to
+   * an external interrupt; on the ALog BottleLogger, this is \b 3.
+   *
+   * @param meters_per_second_per_rotation: Conversion factor between
+   * revolutions and wind speed; see Anemometer_reed_switch().
+   *
+   * @details
+   * Unlike Anemometer_reed_switch(), this does not keep the logger awake
+   * while it counts. Each rotation wakes the MCU for just long enough to
+   * count it, and the watchdog keeps track of the peak wind speed: it ticks
+   * every ~1 s, or every ~16 ms until the reed switch has opened again.
+   * At each logging event, startLogging() writes the following right after
+   * the time stamp, and then resets the count:
+   * * Number of rotations during the logging interval
+   * * Mean wind speed over the logging interval [m/s]
+   * * Peak wind speed: the most rotations within ~1 s of watchdog ticks
+   *   [m/s].
+   *   The watchdog oscillator is only accurate to ~10%, and rotations counted
+   *   while the logger is awake are not included in this peak.
+   *
+   * Call this in setup(), before setupLogger(). On the ALog BottleLogger,
+   * Pin 3 (INT1) is the only free external interrupt, so this cannot be used
+   * alongside TippingBucketRainGage_accumulate() or a rain gauge that is set
+   * up through \b _ext_int in initialize().
+   *
+   * ALog supplies the watchdog interrupt, ISR(WDT_vect). A sketch that
+   * defines its own instead must call _accumulators_watchdog_tick() from it.
+   *
+   * Example:
+   * ```
+   * // Inspeed Vortex wind sensor on digital pin 3
+   * alog.Anemometer_reed_switch_accumulate(3, 1.1176);
+   * ```
+   *
+   */
+  _wind_accumulator_pin = interrupt_pin_number;
+  _accumulator_meters_per_second_per_rotation = \
+                                             meters_per_second_per_rotation;
+  pinMode(interrupt_pin_number, INPUT);
+  digitalWrite(interrupt_pin_number, HIGH); // enable internal 20K pull-up
 }
 
 void ALog::Wind_Vane_Inspeed(uint8_t vanePin){
@@ -2920,13 +4659,7 @@ void ALog::Wind_Vane_Inspeed(uint8_t vanePin){
   // SAVE DATA //
   ///////////////
 
-  // SD write
-  datafile.print("Wind azimuth [degrees]");
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(Wind_angle);
-  Serial.print(F(","));
+  write_value(Wind_angle, 2);
 }
 
 void ALog::Pyranometer(uint8_t analogPin, float raw_mV_per_W_per_m2, \
@@ -2977,18 +4710,12 @@ void ALog::Pyranometer(uint8_t analogPin, float raw_mV_per_W_per_m2, \
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Radiation [W/m^2]");
-    headerfile.print(",");
+    headerfile.print(F("Radiation [W/m^2]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print("Solar Radiation [W/m^2]");
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(Radiation_W_m2, 4);
-  Serial.print(F(","));
+  write_value(Radiation_W_m2, 4);
 }
 
 float ALog::analogReadOversample(uint8_t pin, uint8_t adc_bits, \
@@ -3089,6 +4816,106 @@ float ALog::analogReadOversample(uint8_t pin, uint8_t adc_bits, \
 }
 
 
+void ALog::Barometer_BMP180_start(){
+
+  /**
+   * @brief
+   * Start a BMP180 barometric pressure measurement without waiting for it.
+   *
+   * @details
+   * The BMP180 takes ~5 ms to convert temperature and then ~26 ms to
+   * convert pressure. Call this first, read other sensors while it
+   * converts (optionally calling Barometer_BMP180_poll() between them to
+   * move it on from temperature to pressure), and then call
+   * Barometer_BMP180() to collect and record the result.
+   *
+   * The BMP180's calibration coefficients are read only once, the first
+   * time that the sensor responds, and are kept between logging events.
+   *
+   * Example:
+   * ```
+   * alog.Barometer_BMP180_start();
+   * alog.thermistorB(10000, 3950, 30000, 25, 2); // Runs during conversion
+   * alog.Barometer_BMP180_poll();
+   * alog.maxbotixHRXL_WR_analog();
+   * alog.Barometer_BMP180(); // Record pressure
+   * ```
+   *
+  */
+
+  char status;
+  _bmp180_error = NULL;
+  if (!_bmp180_calibrated){
+    _bmp180_calibrated = _bmp180.begin();
+    Wire.setClock(_i2c_clock_Hz); // begin() restarts I2C at 100 kHz
+    if (!_bmp180_calibrated){
+      _bmp180_error = F("BMP180 init fail");
+      _bmp180_state = BMP180_FINISHED;
+      return;
+    }
+  }
+  // A temperature measurement is needed to calibrate a pressure reading.
+  // If request is successful, the number of ms to wait is returned.
+  // If request is unsuccessful, 0 is returned.
+  status = _bmp180.startTemperature();
+  if (status == 0){
+    _bmp180_error = F("Er start T");
+    _bmp180_state = BMP180_FINISHED;
+    return;
+  }
+  _bmp180_ready_millis = millis() + status;
+  _bmp180_state = BMP180_CONVERTING_TEMPERATURE;
+}
+
+bool ALog::Barometer_BMP180_poll(){
+
+  /**
+   * @brief
+   * Move a BMP180 measurement along, if its current conversion is done.
+   *
+   * @details
+   * Returns immediately. Returns true once the pressure is ready (or the
+   * measurement has failed), and false while a conversion is in progress.
+   * See Barometer_BMP180_start().
+   *
+  */
+
+  char status;
+  if (_bmp180_state == BMP180_IDLE || _bmp180_state == BMP180_FINISHED){
+    return true;
+  }
+  if ((long)(millis() - _bmp180_ready_millis) < 0){
+    return false;
+  }
+  if (_bmp180_state == BMP180_CONVERTING_TEMPERATURE){
+    // Function returns 1 if successful, 0 if failure.
+    if (_bmp180.getTemperature(_bmp180_T) == 0){
+      _bmp180_error = F("Er retrieve T");
+      _bmp180_state = BMP180_FINISHED;
+      return true;
+    }
+    // Start a pressure measurement:
+    // The parameter is the oversampling setting, from 0 to 3 (highest res,
+    // longest wait).
+    status = _bmp180.startPressure(3);
+    if (status == 0){
+      _bmp180_error = F("Er start P");
+      _bmp180_state = BMP180_FINISHED;
+      return true;
+    }
+    _bmp180_ready_millis = millis() + status;
+    _bmp180_state = BMP180_CONVERTING_PRESSURE;
+    return false;
+  }
+  // BMP180_CONVERTING_PRESSURE
+  // Requires the previous temperature measurement (T).
+  if (_bmp180.getPressure(_bmp180_P, _bmp180_T) == 0){
+    _bmp180_error = F("Er retrieve P");
+  }
+  _bmp180_state = BMP180_FINISHED;
+  return true;
+}
+
 void ALog::Barometer_BMP180(){
 
   /**
@@ -3099,6 +4926,10 @@ void ALog::Barometer_BMP180(){
    * This function reads the absolute pressure in mbar (hPa).  BMP180 sensor
    * incorporates on board temperature correction.  Uses I2C protocol.
    *
+   * If Barometer_BMP180_start() has been called, this finishes and records
+   * that measurement; otherwise, it takes a new measurement from start to
+   * finish.
+   *
    * Example:
    * ```
    * alog.Barometer_BMP180();
@@ -3106,76 +4937,33 @@ void ALog::Barometer_BMP180(){
    *
   */
 
-  SFE_BMP180 pressure;
-  char status;
-  double P;
-  double T;
+  if (_bmp180_state == BMP180_IDLE){
+    Barometer_BMP180_start();
+  }
+  while (!Barometer_BMP180_poll()){
+    delay(1);
+  }
+  _bmp180_state = BMP180_IDLE;
 
-  if (pressure.begin())
-  {
-  // A temperature measurement is needed to calibrate a pressure reading.
-  // Start a temperature measurement:
-  // If request is successful, the number of ms to wait is returned.
-  // If request is unsuccessful, 0 is returned.
-  status = pressure.startTemperature();
-  if (status != 0)
-  {
-    delay(status);  //Wait for the measurement to complete:
-    // Retrieve the completed temperature measurement:
-    // Note that the measurement is stored in the variable T.
-    // Function returns 1 if successful, 0 if failure.
-    status = pressure.getTemperature(T);
-    if (status != 0)
-    {
-      // Start a pressure measurement:
-      // The parameter is the oversampling setting, from 0 to 3 (highest res, longest wait).
-      // If request is successful, the number of ms to wait is returned.
-      // If request is unsuccessful, 0 is returned.
-      status = pressure.startPressure(3);
-      if (status != 0)
-      {
-        delay(status);  // Wait for the measurement to complete:
-        // Retrieve the completed pressure measurement:
-        // Note that the measurement is stored in the variable P.
-        // Note also that the function requires the previous temperature
-        // measurement (T).
-        // (If temperature is stable, you can do one temperature measurement
-        // for a number of pressure measurements.)
-        // Function returns 1 if successful, 0 if failure.
-        status = pressure.getPressure(P,T);
-        if (status != 0)
-        {
-          ///////////////
-          // SAVE DATA //
-          ///////////////
-
-          if (first_log_after_booting_up){
-            headerfile.print("Barometric pressure [hPa]");
-            headerfile.print(",");
-            headerfile.sync();
-          }
+  if (_bmp180_error == NULL){
+    ///////////////
+    // SAVE DATA //
+    ///////////////
 
-          // SD write
-          //datafile.print(T);
-          //datafile.print(F(","));
-          datafile.print(P,2);
-          datafile.print(F(","));
-
-          // Echo to serial
-          //Serial.print(T);
-          //Serial.print(F(","));
-          Serial.print(P);
-          Serial.print(F(","));
-          }
-          else Serial.println(F("Er retrieve P"));
-        }
-        else Serial.println(F("Er start P"));
-      }
-      else Serial.println(F("Er retrieve T"));
+    if (first_log_after_booting_up){
+      headerfile.print(F("Barometric pressure [hPa]"));
+      headerfile.print(F(","));
+      headerfile.sync();
     }
-    else Serial.println(F("Er start T"));
+
+    // SD write
+    //datafile.print(T);
+    //datafile.print(F(","));
+    write_value(_bmp180_P, 2);
+  }
+  else {
+    Serial.println(_bmp180_error);
   }
-else Serial.println(F("BMP180 init fail"));
 
 // Note: this is currnetly not printing to header or results if it is not
 // working; it is like it is not even there in this case.
@@ -3225,18 +5013,12 @@ void ALog::_sensor_function_template(uint8_t pin, float param1, float param2,
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Some variable [units]");
-    headerfile.print(",");
+    headerfile.print(F("Some variable [units]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(Some_variable);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(Some_variable);
-  Serial.print(F(","));
+  write_value(Some_variable, 2);
 
 }
 
@@ -3255,6 +5037,7 @@ void ALog::sleepNow_nap()         // here we put the arduino to sleep between in
     // After waking, run sleep mode function, and then remainder of this function (below)
     sleep_disable();         // first thing after waking from sleep:
                              // disable sleep...
+    _rtc_cache_valid = false; // millis() stopped during the nap
     // detachInterrupt(1); // crude, but keeps interrupts from clashing. Need to improve this to allow both measurements types!
     // 06-11-2015: The above line commented to allow the rain gage to be read
     // at the same time as other readings
@@ -3266,10 +5049,124 @@ void _ISR_void(){
 }
 
 void _anemometer_count_increment(){
-  rotation_count ++;
-  detachInterrupt(1);
-  delay(20); // debounce
-  attachInterrupt(digitalPinToInterrupt(3), _anemometer_count_increment, FALLING);
+  // Debounce by ignoring edges within 20 ms of the last counted rotation;
+  // delay() cannot be used to wait inside of an interrupt
+  unsigned long _micros_now = micros();
+  if (_micros_now - _anemometer_last_rotation_micros >= 20000UL){
+    rotation_count ++;
+    _anemometer_last_rotation_micros = _micros_now;
+  }
+}
+
+// Background accumulators: edge-triggered while awake (debounced with
+// micros(), as above), level-triggered while asleep. A level-triggered
+// interrupt disarms itself and speeds up the watchdog; the next watchdog
+// tick re-arms it if the switch has opened again, so the MCU goes straight
+// back to power-down instead of waiting for the switch.
+void _wind_accumulator_edge(){
+  unsigned long _micros_now = micros();
+  if (_micros_now - _wind_accumulator_last_micros >= 20000UL){
+    _wind_accumulated_rotations ++;
+    _wind_accumulator_last_micros = _micros_now;
+  }
+}
+
+void _wind_accumulator_level(){
+  _wind_accumulated_rotations ++;
+  _wind_accumulator_armed = false;
+  detachInterrupt(digitalPinToInterrupt(_wind_accumulator_pin));
+  if (!_accumulators_fast_tick){
+    _accumulators_watchdog_period(true);
+  }
+}
+
+void _rain_accumulator_edge(){
+  // 50 ms, as for TippingBucketRainGage(), so tips aren't double-counted
+  unsigned long _micros_now = micros();
+  if (_micros_now - _rain_accumulator_last_micros >= 50000UL){
+    _rain_accumulated_tips ++;
+    _rain_accumulator_last_micros = _micros_now;
+  }
+}
+
+void _rain_accumulator_level(){
+  _rain_accumulated_tips ++;
+  _rain_accumulator_armed = false;
+  detachInterrupt(digitalPinToInterrupt(_rain_accumulator_pin));
+  if (!_accumulators_fast_tick){
+    _accumulators_watchdog_period(true);
+  }
+}
+
+// Watchdog in interrupt (not reset) mode: ~16 ms ticks (fast) to re-arm a
+// switch soon after it opens, or ~1 s ticks otherwise. startLogging()
+// returns it to its usual 8 s reset mode.
+void _accumulators_watchdog_period(bool fast){
+  uint8_t oldSREG = SREG;
+  cli();
+  _accumulators_fast_tick = fast;
+  wdt_reset();
+  WDTCSR |= _BV(WDCE) | _BV(WDE);
+  if (fast){
+    WDTCSR = _BV(WDIE);
+  }
+  else {
+    WDTCSR = _BV(WDIE) | _BV(WDP2) | _BV(WDP1);
+  }
+  SREG = oldSREG;
+}
+
+// Watchdog tick while asleep with the accumulators running: re-arm any
+// switch that has opened since it was counted (at least ~16 ms ago, so it
+// has stopped bouncing), and track the most rotations per ~1 s and the
+// most bucket tips per ~1 min for the peak wind speed and rain intensity.
+void _accumulators_watchdog_tick(){
+  if (_wind_accumulator_pin != -1 && !_wind_accumulator_armed && \
+      digitalRead(_wind_accumulator_pin) == HIGH){
+    _wind_accumulator_armed = true;
+    attachInterrupt(digitalPinToInterrupt(_wind_accumulator_pin), \
+                    _wind_accumulator_level, LOW);
+  }
+  if (_rain_accumulator_pin != -1 && !_rain_accumulator_armed && \
+      digitalRead(_rain_accumulator_pin) == HIGH){
+    _rain_accumulator_armed = true;
+    attachInterrupt(digitalPinToInterrupt(_rain_accumulator_pin), \
+                    _rain_accumulator_level, LOW);
+  }
+
+  // The 1 s period is 64 times the 16 ms one
+  _accumulator_tick_units += _accumulators_fast_tick ? 1 : 64;
+  if (_accumulator_tick_units >= 64){
+    _accumulator_tick_units = 0;
+    uint32_t _rotations = _wind_accumulated_rotations;
+    if (_rotations - _wind_rotations_at_tick > _wind_max_rotations_per_tick){
+      _wind_max_rotations_per_tick = _rotations - _wind_rotations_at_tick;
+    }
+    _wind_rotations_at_tick = _rotations;
+    _rain_tick_seconds ++;
+    if (_rain_tick_seconds >= 60){
+      _rain_tick_seconds = 0;
+      uint16_t _tips = _rain_accumulated_tips;
+      if (_tips - _rain_tips_at_minute > _rain_max_tips_per_minute){
+        _rain_max_tips_per_minute = _tips - _rain_tips_at_minute;
+      }
+      _rain_tips_at_minute = _tips;
+    }
+  }
+
+  // Back to ~1 s ticks once every switch is armed
+  if (_accumulators_fast_tick && \
+      (_wind_accumulator_pin == -1 || _wind_accumulator_armed) && \
+      (_rain_accumulator_pin == -1 || _rain_accumulator_armed)){
+    _accumulators_watchdog_period(false);
+  }
+}
+
+// Weak, so that a sketch may define its own watchdog interrupt without a
+// link error; if it does, and uses the accumulators, its ISR(WDT_vect)
+// must call _accumulators_watchdog_tick()
+ISR(WDT_vect, __attribute__((weak))){
+  _accumulators_watchdog_tick();
 }
 
 void ALog::HackHD(int control_pin, bool want_camera_on){
@@ -3362,21 +5259,21 @@ void ALog::HackHD(int control_pin, bool want_camera_on){
     // Use this to get times of camera on/off
     start_logging_to_otherfile("camera.txt");
 
-    now = RTC.now();
+    now = _rtcNow();
 
     // SD
-    otherfile.print(now.unixtime());
-    otherfile.print(",");
+    print_timestamp(otherfile);
+    otherfile.print(F(","));
 
     // Echo to serial
-    Serial.print(now.unixtime());
+    print_timestamp(Serial);
     Serial.print(F(","));
 
     if (want_camera_on == 1){
-      otherfile.print("ON");
+      otherfile.print(F("ON"));
     }
     else if (want_camera_on == 0){
-      otherfile.print("OFF");
+      otherfile.print(F("OFF"));
     }
     end_logging_to_otherfile();
   }
@@ -3410,26 +5307,30 @@ void ALog::TippingBucketRainGage(){
 
   delay(10);
   start_logging_to_otherfile("bucket_tips.txt");
-  now = RTC.now();
+  now = _rtcNow();
 
   // SD
-  otherfile.print(now.unixtime());
-  otherfile.print(",");
+  print_timestamp(otherfile);
+  otherfile.print(F(","));
 
   // Echo to serial
-  Serial.print(now.unixtime());
+  print_timestamp(Serial);
   Serial.print(F(","));
   end_logging_to_otherfile();
 
   // START TEMPORARY CODE TO NOTE BUCKET TIP RESPONSE
-  pinMode(LEDpin, OUTPUT);
-  digitalWrite(LEDpin, HIGH);
+  if (ALOG_PIN(LEDpin) >= 0){
+    pinMode(ALOG_PIN(LEDpin), OUTPUT);
+  }
+  ALOG_PIN_WRITE(LEDpin, HIGH);
   // END TEMPORARY CODE TO NOTE BUCKET TIP RESPONSE
   Serial.println(F("Tip!"));
   delay(50); // to make sure tips aren't double-counted
   // START TEMPORARY CODE TO NOTE BUCKET TIP RESPONSE
-  digitalWrite(LEDpin, LOW);
-  pinMode(LEDpin, INPUT);
+  ALOG_PIN_WRITE(LEDpin, LOW);
+  if (ALOG_PIN(LEDpin) >= 0){
+    pinMode(ALOG_PIN(LEDpin), INPUT);
+  }
   // END TEMPORARY CODE TO NOTE BUCKET TIP RESPONSE
   NEW_RAIN_BUCKET_TIP = false;
 
@@ -3439,19 +5340,175 @@ void ALog::TippingBucketRainGage(){
     IS_LOGGING = true;
   }
 
-  //delay(2000);
+  //delay(2000);
+
+  attachInterrupt(digitalPinToInterrupt(3), wakeUpNow_tip, LOW);
+
+  // Then based on whether we are already logging or if we are supposed to
+  // start logging here, we can continue with the logging process, or just
+  // go back to sleep
+  if (_use_sleep_mode){
+    // Nested recursion to next-level-up function, hopefully doesn't
+    // chew through too much memory!
+    if (!IS_LOGGING){
+      sleep();
+    }
+  }
+}
+
+void ALog::TippingBucketRainGage_accumulate(uint8_t interrupt_pin_number, \
+           float mm_per_tip){
+  /**
+   * @brief
+   * Count tipping-bucket rain gauge tips in the background, and report them
+   * once per logging interval.
+   *
+   * @param interrupt_pin_number is the digital pin number corresponding to
+   * an external interrupt; on the ALog BottleLogger, this is \b 3.
+   *
+   * @param mm_per_tip is the depth of rain [mm] that fills one bucket.
+   *
+   * @details
+   * This is an alternative to the \b _ext_int option in initialize(), which
+   * wakes the logger fully and writes a time stamp to "bucket_tips.txt" for
+   * every tip. Here, each tip wakes the MCU only for long enough to count it,
+   * and startLogging() writes the following right after the time stamp:
+   * * Number of bucket tips during the logging interval
+   * * Rainfall during the logging interval [mm]
+   * * Mean rainfall intensity over the logging interval [mm/hr]
+   * * Peak rainfall intensity: the most tips within ~1 minute of watchdog
+   *   ticks [mm/hr]. As for the peak wind speed in
+   *   Anemometer_reed_switch_accumulate(), the watchdog is only accurate to
+   *   ~10%, tips while the logger is awake are not included, and only
+   *   whole minutes of sleep count (so this is 0 for shorter intervals).
+   *
+   * Call this in setup(), before setupLogger(), and leave \b _ext_int false.
+   *
+   * Example:
+   * ```
+   * // 0.2 mm per tip, on digital pin 3
+   * alog.TippingBucketRainGage_accumulate(3, 0.2);
+   * ```
+   *
+   */
+  _rain_accumulator_pin = interrupt_pin_number;
+  _accumulator_mm_per_tip = mm_per_tip;
+  pinMode(interrupt_pin_number, INPUT);
+  digitalWrite(interrupt_pin_number, HIGH); // enable internal 20K pull-up
+}
+
+void ALog::accumulators_awake(){
+  // Edge-triggered counting while the logger is awake
+  if (_wind_accumulator_pin != -1){
+    detachInterrupt(digitalPinToInterrupt(_wind_accumulator_pin));
+    _wind_accumulator_armed = true;
+    attachInterrupt(digitalPinToInterrupt(_wind_accumulator_pin), \
+                    _wind_accumulator_edge, FALLING);
+  }
+  if (_rain_accumulator_pin != -1){
+    detachInterrupt(digitalPinToInterrupt(_rain_accumulator_pin));
+    _rain_accumulator_armed = true;
+    attachInterrupt(digitalPinToInterrupt(_rain_accumulator_pin), \
+                    _rain_accumulator_edge, FALLING);
+  }
+}
+
+void ALog::accumulators_asleep(){
+  // Level-triggered counting while asleep: only LOW can wake the MCU from
+  // power-down. The first watchdog tick arms every switch that is open
+  // then, including one that is closed right now.
+  noInterrupts();
+  if (_wind_accumulator_pin != -1){
+    detachInterrupt(digitalPinToInterrupt(_wind_accumulator_pin));
+    _wind_accumulator_armed = false;
+  }
+  if (_rain_accumulator_pin != -1){
+    detachInterrupt(digitalPinToInterrupt(_rain_accumulator_pin));
+    _rain_accumulator_armed = false;
+  }
+
+  // Peak wind speed and rain intensity are measured from here on
+  _accumulator_tick_units = 0;
+  _wind_rotations_at_tick = _wind_accumulated_rotations;
+  _rain_tick_seconds = 0;
+  _rain_tips_at_minute = _rain_accumulated_tips;
+  interrupts();
 
-  attachInterrupt(digitalPinToInterrupt(3), wakeUpNow_tip, LOW);
+  _accumulators_watchdog_period(true);
+}
 
-  // Then based on whether we are already logging or if we are supposed to
-  // start logging here, we can continue with the logging process, or just
-  // go back to sleep
-  if (_use_sleep_mode){
-    // Nested recursion to next-level-up function, hopefully doesn't
-    // chew through too much memory!
-    if (!IS_LOGGING){
-      sleep();
+void ALog::record_accumulators(){
+  // Report and reset the background counters; "now" was just read by
+  // unixDatestamp()
+  uint32_t _rotations;
+  uint16_t _max_rotations_per_tick;
+  uint16_t _tips;
+  uint16_t _max_tips_per_minute;
+  noInterrupts();
+  _rotations = _wind_accumulated_rotations;
+  _max_rotations_per_tick = _wind_max_rotations_per_tick;
+  _tips = _rain_accumulated_tips;
+  _wind_accumulated_rotations = 0;
+  _wind_rotations_at_tick = 0;
+  _wind_max_rotations_per_tick = 0;
+  _max_tips_per_minute = _rain_max_tips_per_minute;
+  _rain_accumulated_tips = 0;
+  _rain_tips_at_minute = 0;
+  _rain_max_tips_per_minute = 0;
+  interrupts();
+
+  float interval_seconds = now.unixtime() - _accumulation_start_unixtime;
+  _accumulation_start_unixtime = now.unixtime();
+
+  if (_wind_accumulator_pin != -1){
+    float mean_wind_speed = -9999;
+    if (interval_seconds > 0){
+      mean_wind_speed = _rotations / interval_seconds * \
+                        _accumulator_meters_per_second_per_rotation;
+    }
+    float peak_wind_speed = _max_rotations_per_tick * \
+                            _accumulator_meters_per_second_per_rotation;
+
+    if (first_log_after_booting_up){
+      headerfile.print(F("Anemometer rotations during interval"));
+      headerfile.print(F(","));
+      headerfile.print(F("Mean wind speed during interval [m/s]"));
+      headerfile.print(F(","));
+      headerfile.print(F("Peak wind speed (max ~1-s tick) [m/s]"));
+      headerfile.print(F(","));
+      headerfile.sync();
+    }
+
+    write_value(_rotations, 0);
+    write_value(mean_wind_speed, 4);
+    write_value(peak_wind_speed, 4);
+  }
+
+  if (_rain_accumulator_pin != -1){
+    float rainfall_mm = _tips * _accumulator_mm_per_tip;
+    float rainfall_intensity = -9999;
+    if (interval_seconds > 0){
+      rainfall_intensity = rainfall_mm / interval_seconds * 3600.;
+    }
+    float peak_rainfall_intensity = _max_tips_per_minute * \
+                                    _accumulator_mm_per_tip * 60.;
+
+    if (first_log_after_booting_up){
+      headerfile.print(F("Rain gauge bucket tips during interval"));
+      headerfile.print(F(","));
+      headerfile.print(F("Rainfall during interval [mm]"));
+      headerfile.print(F(","));
+      headerfile.print(F("Mean rainfall intensity during interval [mm/hr]"));
+      headerfile.print(F(","));
+      headerfile.print(F("Peak rainfall intensity (max ~1-min) [mm/hr]"));
+      headerfile.print(F(","));
+      headerfile.sync();
     }
+
+    write_value(_tips, 0);
+    write_value(rainfall_mm, 2);
+    write_value(rainfall_intensity, 2);
+    write_value(peak_rainfall_intensity, 2);
   }
 }
 
@@ -3465,11 +5522,31 @@ void ALog::start_logging_to_datafile(){
   }
 }
 
+void ALog::start_logging_to_rawfile(){
+  // Open the file for writing
+  if (!rawfile.open("raw.txt", O_WRITE | O_CREAT | O_AT_END)) {
+    Serial.print(F("Opening "));
+    Serial.print(F("raw.txt"));
+    Serial.println(F(" for write failed"));
+  delay(10);
+  }
+}
+
+void ALog::start_logging_to_binaryfile(){
+  // Open the file for writing
+  if (!binaryfile.open("data.bin", O_WRITE | O_CREAT | O_AT_END)) {
+    Serial.print(F("Opening "));
+    Serial.print(F("data.bin"));
+    Serial.println(F(" for write failed"));
+  delay(10);
+  }
+}
+
 void ALog::start_logging_to_headerfile(){
   // Open the file for writing
   if (!headerfile.open("header.txt", O_WRITE | O_CREAT | O_AT_END)) {
     Serial.print(F("Opening "));
-    Serial.print("header.txt");
+    Serial.print(F("header.txt"));
     Serial.println(F(" for write failed"));
   delay(10);
   }
@@ -3501,6 +5578,33 @@ void ALog::end_logging_to_headerfile(){
   // Ends line and closes otherfile
   // Copied from endLine function
   headerfile.println();
+  if (_aggregation.active()){
+    headerfile.print(F("Data file lines are statistics over windows of "));
+    headerfile.print(_aggregation.window_seconds());
+    headerfile.println(F(" s: the time at which the window starts, then, for \
+each column after the time stamp above, the mean, minimum, maximum, \
+standard deviation, and number of readings"));
+    if (_aggregate_keep_raw){
+      headerfile.println(F("Every reading is in raw.txt, in the columns above"));
+    }
+  }
+  if (_binary){
+    headerfile.println(F("Data, in the columns above, are compressed in \
+data.bin; decode with doc/decodeBinary.py"));
+  }
+  if (_battery_thresholds_refused){
+    headerfile.println(F("Battery thresholds ignored: above the 3.3 V supply \
+that this board measures"));
+  }
+  if (_line.overflowed()){
+    headerfile.print(F("Data lines are longer than their buffer, so each is \
+written in pieces: to write each at once, use set_line_buffer_length("));
+    headerfile.print(_line.longest_line());
+    headerfile.println(F(") or more"));
+  }
+  // Memory check for this boot: setup and one full logging event
+  headerfile.print(F("Minimum free RAM after first log [bytes]: "));
+  headerfile.println(get_min_free_ram());
   // close the file: (This does the actual sync() step too - writes buffer)
   headerfile.close();
   delay(10);
@@ -3522,6 +5626,10 @@ void ALog::Decagon5TE(uint8_t excitPin, uint8_t dataPin){
    * however, we have a time limit, so this won't crash the logger: it will
    * just keep the logger from recording good data.
    *
+   * The probe is powered only until its data frame and checksum have been
+   * received (typically ~300 ms), or for at most 500 ms. If no valid frame
+   * arrives, all three values are recorded as -9999.
+   *
    * Modified from Steve Hicks' code for an LCD reader by Andy Wickert
    *
    * @param excitPin activates the probe and powers it
@@ -3535,72 +5643,53 @@ void ALog::Decagon5TE(uint8_t excitPin, uint8_t dataPin){
    *
    */
 
-  SoftwareSerial mySerial(excitPin, dataPin);  //5tm's red wire (serial data out) connected to pin 5, pin 6 goes nowhere
-  int Epsilon_Raw, Sigma_Raw, T_Raw;   //temporary integer variables to store the 3 parts of the incoming serial stream from the 5TM
-  char dataStream[14];   // Max 14 characters: 4x3 + 2 spaces
-  int startflag=1;
-  int endflag=0;
-  int i=0;
-  unsigned int startMillis; // same comment as right below
-  unsigned int elapsed = 0; // shouldn't overflow on the time scales I'm using
-
-  if(startflag){
-    digitalWrite(excitPin,HIGH);
-    delay(100); // max. time for probe's comms to start up (see datasheet)
-    startMillis = millis();
-    startflag=0;
-    Serial.println(startMillis);
-  }
+  // Decagon DDI serial frame, read by ALogDDIFrame (see ALogCore.cpp)
+  ALogDDIFrame frame;
 
-  // Start serial port
+  // Data (probe's serial out) on dataPin; the excitation pin is given as the
+  // SoftwareSerial transmit pin, as nothing is sent to the probe.
+  // Receiving is interrupt-driven (pin change), so the frame is parsed from
+  // the SoftwareSerial buffer one character at a time as it arrives.
+  SoftwareSerial mySerial(dataPin, excitPin);
+  // Start listening before exciting the probe so that the start of the
+  // frame is not missed
   // Using standard Decagon DDI Serial; simpler than SDI-12
   mySerial.begin(1200); // 1200 bits per second
-
-  // OK if it takes longer, so long as data stream is continuous
-  // so we don't break out of inner while loop, and we start
-  // receiving before 200 ms is up
-  while (elapsed < 200){
-    elapsed = millis() - startMillis;
-    Serial.print(F("ms elapsed = "));
-    Serial.println(elapsed);
-    //  code keeps looping until incoming serial data appears on the mySerial pin
-    while (mySerial.available()) {
-      //Serial.println("Getting data:");
-        delay(1);
-      if (mySerial.available() >0) {
-    		endflag=1;
-        char c = mySerial.read();  //gets one byte from serial buffer
-          Serial.println(c);
-        if((c>='0' and c<='9') || c==' ') {
-         dataStream[i] = c; //makes the string readString
-         i++;
-        }
-      }
+  digitalWrite(excitPin, HIGH);
+  unsigned long startMillis = millis();
+
+  // The probe starts talking within ~150 ms, and the frame takes ~120 ms
+  // at 1200 bps. Stop as soon as the frame is complete, or give up after
+  // 500 ms if the probe is missing or the frame is garbled.
+  while ((millis() - startMillis) < 500){
+    if (mySerial.available() && frame.add(mySerial.read())){
+      break;
     }
   }
+  digitalWrite(excitPin, LOW);
+  mySerial.end();
 
-  if(endflag==1){
+  int Epsilon_Raw = frame.value(0);
+  int Sigma_Raw = frame.value(1);
+  int T_Raw = frame.value(2);
 
-    digitalWrite(excitPin,LOW);
-    Serial.println(dataStream);
-    endflag=0;
+  float Epsilon_a;
+  float EC;
+  float T;
 
-    // Declare to make C++ happy
-    float Epsilon_a;
-    float EC;
-    float T;
-
-    // parse the array into 3 integers  (for the 5TM, y is always 0)
-    sscanf (dataStream, "%d %d %d", &Epsilon_Raw, &Sigma_Raw, &T_Raw);
-
-    // Change measured values into real values, via equations in Decagon 5TE
-    // manual
+  // Change measured values into real values, via equations in Decagon 5TE
+  // manual
 
+  if (!frame.good()){
+    // No probe, timeout, or checksum error
+    Epsilon_a = -9999;
+    EC = -9999;
+    T = -9999;
+  }
+  else {
     // Dielectric permittivity [-unitless-]
     if (Epsilon_Raw == 4095){
       // Error alert!
-      //delete Epsilon_a;
-      //char Epsilon_a[6] = "ERROR";
       Epsilon_a = -9999;
     }
     else {
@@ -3609,63 +5698,250 @@ void ALog::Decagon5TE(uint8_t excitPin, uint8_t dataPin){
     // Electrical Conductivity [dS/m]
     if (Sigma_Raw == 1023){
       // Error alert!
-      //char EC[6] = "ERROR";
       EC = -9999;
     }
     else if (Sigma_Raw <= 700){
       EC = Sigma_Raw/100.;
     }
     else {
-      // (i.e. Sigma_Raw > 700, but no elif needed so long as input string
-      // parses correctly... hmm, should maybe protect against that)
       EC = (700. + 5.*(Sigma_Raw- 700.))/100.;
     }
     // Temperature [degrees C]
     // Combined both steps of the operation as given in the manual
     if (T_Raw == 1023){
       // Error alert!
-      // char T[6] = "ERROR";
       T = -9999;
     }
     else if (T_Raw <= 900){
       T = (T_Raw - 400.) / 10.;
     }
     else {
-      // (i.e. T_Raw > 900, but no elif needed so long as input string
-      // parses correctly... hmm, should maybe protect against that)
       T = ((900. + 5.*(T_Raw-900.) - 400.)) / 10.;
     }
+  }
 
-    ///////////////
-    // SAVE DATA //
-    ///////////////
+  ///////////////
+  // SAVE DATA //
+  ///////////////
+
+  if (first_log_after_booting_up){
+    headerfile.print(F("Dielectric permittivity [-]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Electrical Conductivity [dS/m]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Temperature [degrees C]"));
+    headerfile.print(F(","));
+    headerfile.sync();
+  }
+
+  write_value(Epsilon_a, 2);
+  write_value(EC, 2);
+  write_value(T, 2);
+}
+
+void ALog::SDI12_concurrent(uint8_t dataPin, const char* addresses, \
+                            uint8_t nvalues){
+  /**
+   * @brief
+   * Reads many SDI-12 sensors on one data wire, measuring all at once.
+   *
+   * @details
+   * Sends a concurrent measurement command (aC!) to every sensor listed,
+   * waits once, until the last of them is ready (each one's measurement
+   * time after it was started), and then collects each sensor's data (aD0!, aD1!, ...). Total time is
+   * that of the slowest sensor, not the sum of all of them.
+   *
+   * The ALog is the bus master; the SDI-12 signal (1200 bps, 7 data bits,
+   * even parity, inverted logic) is generated and read directly on the data
+   * pin, so no additional hardware UART or SoftwareSerial is needed. Power
+   * the sensors (typically 12V) before calling this, and connect their data
+   * wires together to dataPin.
+   *
+   * Each sensor is given nvalues columns; missing values (e.g., a sensor that
+   * does not respond, or returns fewer values) are recorded as -9999.
+   *
+   * @param dataPin Digital pin connected to the SDI-12 data line
+   *
+   * @param addresses Character array of sensor addresses, e.g., "012"
+   *
+   * @param nvalues Number of values to record from each sensor
+   *
+   * Example:
+   * ```
+   * // Three Decagon 5TE probes (addresses 0, 1, and 2) on pin 6, each
+   * // returning dielectric permittivity, conductivity, and temperature
+   * alog.SDI12_concurrent(6, "012", 3);
+   * ```
+   */
+
+  char response[SDI12_MAX_RESPONSE_LENGTH + 1];
+  char command[5];
+  uint8_t naddresses = strlen(addresses);
+  uint16_t wait_seconds;
+  unsigned long ready_millis;
+  // Latest time at which a sensor will be ready
+  unsigned long last_ready_millis = millis();
+
+  // Start measurements on all sensors: response to aC! is atttnn. Each
+  // sensor's measurement time runs from its own response, which comes
+  // ~100 ms or more after the one before.
+  for (uint8_t i=0; i<naddresses; i++){
+    command[0] = addresses[i];
+    command[1] = 'C';
+    command[2] = '!';
+    command[3] = '\0';
+    if (sdi12_command(dataPin, command, response) >= 4 && \
+        response[0] == addresses[i]){
+      wait_seconds = 100*(response[1]-'0') + 10*(response[2]-'0') + \
+                     (response[3]-'0');
+      ready_millis = millis() + 1000UL*wait_seconds;
+      if ((long)(ready_millis - last_ready_millis) > 0){
+        last_ready_millis = ready_millis;
+      }
+    }
+  }
 
+  // Wait once, until the last sensor is ready
+  while ((long)(last_ready_millis - millis()) > 0){
+    wdt_reset(); // Some sensors take longer than the 8 s watchdog
+    delay(10);
+  }
+
+  // Collect and record the data: response to aDn! is a<values>, each value
+  // starting with its sign, e.g., 0+1.23-4.5+22
+  float value;
+  char* cursor;
+  char* next;
+  uint8_t nvalues_received;
+  for (uint8_t i=0; i<naddresses; i++){
+    nvalues_received = 0;
+    // Up to 10 data commands (aD0! -- aD9!) per measurement
+    for (uint8_t n=0; n<10 && nvalues_received<nvalues; n++){
+      command[0] = addresses[i];
+      command[1] = 'D';
+      command[2] = '0' + n;
+      command[3] = '!';
+      command[4] = '\0';
+      if (sdi12_command(dataPin, command, response) < 3 || \
+          response[0] != addresses[i]){
+        break;
+      }
+      cursor = response + 1;
+      while (*cursor == '+' || *cursor == '-'){
+        value = strtod(cursor, &next);
+        if (next == cursor){
+          break;
+        }
+        cursor = next;
+        if (nvalues_received < nvalues){
+          write_value(value, 4);
+          nvalues_received++;
+        }
+      }
+      if (cursor == response + 1){
+        // No values in this response: nothing more to collect
+        break;
+      }
+    }
+    for (; nvalues_received<nvalues; nvalues_received++){
+      write_value(-9999, 0);
+    }
     if (first_log_after_booting_up){
-      headerfile.print("Dielectric permittivity [-]");
-      headerfile.print(",");
-      headerfile.print("Electrical Conductivity [dS/m]");
-      headerfile.print(",");
-      headerfile.print("Temperature [degrees C]");
-      headerfile.print(",");
+      for (uint8_t k=1; k<=nvalues; k++){
+        headerfile.print(F("SDI-12 sensor "));
+        headerfile.print(addresses[i]);
+        headerfile.print(F(" value "));
+        headerfile.print(k);
+        headerfile.print(F(","));
+      }
       headerfile.sync();
     }
+  }
+}
 
-    // SD write
-    datafile.print(Epsilon_a);
-    datafile.print(F(","));
-    datafile.print(EC);
-    datafile.print(F(","));
-    datafile.print(T);
-    datafile.print(F(","));
+uint8_t ALog::sdi12_command(uint8_t pin, const char* command, \
+                           char* response){
+  // Wakes the sensors with a break, sends the command, and reads the
+  // response up to <CR><LF> into "response" (without the <CR><LF>).
+  // Returns the response length; 0 if there is no response after 3 tries.
+  int c;
+  uint8_t len = 0;
+  for (uint8_t attempt=0; attempt<3 && len==0; attempt++){
+    // Break: >= 12 ms spacing (high), then >= 8.33 ms marking (low)
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, HIGH);
+    delay(13);
+    digitalWrite(pin, LOW);
+    delay(9);
+    for (uint8_t i=0; command[i] != '\0'; i++){
+      sdi12_write_char(pin, command[i]);
+    }
+    // Release the line for the sensor to talk; it must start within 15 ms
+    pinMode(pin, INPUT);
+    c = sdi12_read_char(pin, 20);
+    while (c >= 0 && c != '\n'){
+      if (c != '\r' && len < SDI12_MAX_RESPONSE_LENGTH){
+        response[len++] = c;
+      }
+      // Characters follow each other within 1.66 ms
+      c = sdi12_read_char(pin, 10);
+    }
+  }
+  response[len] = '\0';
+  return len;
+}
 
-    // Echo to serial
-    Serial.print(Epsilon_a);
-    Serial.print(F(","));
-    Serial.print(EC);
-    Serial.print(F(","));
-    Serial.print(T);
-    Serial.print(F(","));
+void ALog::sdi12_write_char(uint8_t pin, char c){
+  // 1200 bps, 1 start bit, 7 data bits (LSB first), even parity, 1 stop bit.
+  // Inverted logic: a 0 bit (and the start bit) is high; a 1 bit is low.
+  // Bits are timed from the start of the character so that interrupts
+  // (e.g., millis) cannot cause the timing to drift.
+  uint16_t frame = 0;
+  uint8_t parity = 0;
+  for (uint8_t i=0; i<7; i++){
+    if (c & (1 << i)){
+      frame |= (1 << (i+1));
+      parity ^= 1;
+    }
+  }
+  frame |= (parity << 8) | (1 << 9); // Start bit (0) is bit 0; stop is a 1
+  unsigned long t0 = micros();
+  for (uint8_t i=0; i<10; i++){
+    digitalWrite(pin, (frame & (1 << i)) ? LOW : HIGH);
+    while ((micros() - t0) < (i+1)*SDI12_BIT_MICROSECONDS){}
+  }
+}
+
+int ALog::sdi12_read_char(uint8_t pin, uint16_t timeout_ms){
+  // Polls for a start bit (line goes high), then samples the middle of each
+  // of the 7 data bits. Returns the character, or -1 on timeout or a
+  // parity error.
+  unsigned long startMillis = millis();
+  while (digitalRead(pin) == LOW){
+    if ((millis() - startMillis) > timeout_ms){
+      return -1;
+    }
   }
+  unsigned long t0 = micros();
+  uint8_t c = 0;
+  uint8_t parity = 0;
+  for (uint8_t i=1; i<=8; i++){
+    while ((micros() - t0) < i*SDI12_BIT_MICROSECONDS + \
+           SDI12_BIT_MICROSECONDS/2){}
+    if (digitalRead(pin) == LOW){
+      // Inverted logic: low = 1
+      parity ^= 1;
+      if (i < 8){
+        c |= (1 << (i-1));
+      }
+    }
+  }
+  // Wait out the stop bit so that the next start bit is a fresh edge
+  while ((micros() - t0) < 10*SDI12_BIT_MICROSECONDS){}
+  if (parity){
+    return -1;
+  }
+  return c;
 }
 
 void ALog::DecagonGS1(uint8_t pin, float Vref, uint8_t ADC_resolution_nbits){
@@ -3707,30 +5983,34 @@ void ALog::DecagonGS1(uint8_t pin, float Vref, uint8_t ADC_resolution_nbits){
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Sensor output voltage [V]");
-    headerfile.print(",");
-    headerfile.print("Volumetric water content [-]");
-    headerfile.print(",");
+    headerfile.print(F("Sensor output voltage [V]"));
+    headerfile.print(F(","));
+    headerfile.print(F("Volumetric water content [-]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(voltage, 4);
-  datafile.print(F(","));
-  datafile.print(volumetric_water_content, 4);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(voltage, 4);
-  Serial.print(F(","));
-  Serial.print(volumetric_water_content, 4);
-  Serial.print(F(","));
+  write_value(voltage, 4);
+  write_value(volumetric_water_content, 4);
 
 }
 
 // Honeywell_HSC_analog
 //////////////////////////////
 
+// Pressure units for Honeywell_HSC_analog(), in flash
+const char HSC_UNITS_0[] PROGMEM = "mbar";
+const char HSC_UNITS_1[] PROGMEM = "bar";
+const char HSC_UNITS_2[] PROGMEM = "Pa";
+const char HSC_UNITS_3[] PROGMEM = "KPa";
+const char HSC_UNITS_4[] PROGMEM = "Mpa";
+const char HSC_UNITS_5[] PROGMEM = "inH2O";
+const char HSC_UNITS_6[] PROGMEM = "PSI";
+const char HSC_UNITS_7[] PROGMEM = "why";
+const char* const HSC_UNITS[] PROGMEM = {HSC_UNITS_0, HSC_UNITS_1, \
+      HSC_UNITS_2, HSC_UNITS_3, HSC_UNITS_4, HSC_UNITS_5, HSC_UNITS_6, \
+      HSC_UNITS_7};
+
 float ALog::Honeywell_HSC_analog(int pin, float Vsupply, float Vref, \
                                    float Pmin, float Pmax, \
                                    int TransferFunction_number, int units, \
@@ -3794,8 +6074,19 @@ float ALog::Honeywell_HSC_analog(int pin, float Vsupply, float Vref, \
   float reading = analogReadOversample(pin, ADC_resolution_nbits);
   float Vout = reading/1023*Vref;
 
+  return Honeywell_HSC_pressure(Vout, Vsupply, Pmin, Pmax, \
+                                TransferFunction_number, units);
+
+}
+
+float ALog::Honeywell_HSC_pressure(float Vout, float Vsupply, float Pmin, \
+            float Pmax, int TransferFunction_number, int units){
+  // Pressure from sensor output voltage, shared by Honeywell_HSC_analog()
+  // and Honeywell_HSC_LTC2495(). A voltage of -9999 (no data) is passed
+  // through.
+
   // Apply transfer function
-  float P;
+  float P = -9999;
 
   if(TransferFunction_number == 1){
   P = (Vout - 0.1*Vsupply) * ((Pmax-Pmin)/(0.8*Vsupply)) + Pmin;
@@ -3809,32 +6100,24 @@ float ALog::Honeywell_HSC_analog(int pin, float Vsupply, float Vref, \
   if(TransferFunction_number == 4){
   P = (Vout - 0.04*Vsupply) * ((Pmax-Pmin)/(0.9*Vsupply)) + Pmin;
   }
-
-  char* _units[]={"mbar", "bar", "Pa", "KPa", "Mpa", "inH2O", "PSI", "why"};
+  if (Vout == -9999){
+    P = -9999;
+  }
 
   ///////////////
   // SAVE DATA //
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Pressure [");
-    headerfile.print(_units[units]);
-    headerfile.print("]");
-    headerfile.print(",");
+    headerfile.print(F("Pressure ["));
+    headerfile.print((const __FlashStringHelper*)
+                     pgm_read_ptr(&HSC_UNITS[units]));
+    headerfile.print(F("]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(P, 4);
-  //datafile.print(F(" "));
-  //datafile.print(_units[units]);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(P, 4);
-  //Serial.print(F(" "));
-  //Serial.print(_units[units]);
-  Serial.print(F(","));
+  write_value(P, 4);
 
   return P;
 
@@ -3870,24 +6153,262 @@ void ALog::vdivR(uint8_t pin, float Rref, uint8_t ADC_resolution_nbits, \
 
   float _R = _vdivR(pin, Rref, ADC_resolution_nbits, Rref_on_GND_side);
 
+  record_resistance(_R);
+
+}
+
+void ALog::record_resistance(float _R){
+  // Shared by vdivR() and vdivR_LTC2495()
+
   ///////////////
   // SAVE DATA //
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Resistance [Ohms]");
-    headerfile.print(",");
+    headerfile.print(F("Resistance [Ohms]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(_R);
-  datafile.print(F(","));
+  write_value(_R, 2);
 
-  // Echo to serial
-  Serial.print(_R);
-  Serial.print(F(","));
+}
+
+// LTC2495 EXTERNAL ADC
+////////////////////////
+
+// The ALog BottleLogger v3 carries a 16-channel, 16-bit + sign delta-sigma
+// ADC on the I2C bus. One conversion gives more resolution than thousands
+// of oversampled readings of the microcontroller's ADC. Each channel is
+// read as a ratio to the 1.8 V precision reference (REF_1V8) on channel 15,
+// so the ADC's own reference voltage, and its drift, cancel out.
+
+bool ALog::ltc2495_transfer(uint8_t next_channel, int32_t &previous_code){
+  // Program the channel to convert next and read the result of the
+  // conversion that has just finished, in one transaction: the LTC2495
+  // starts on next_channel as soon as the result is read, so the I2C
+  // traffic for one channel overlaps the conversion of the next.
+  // The LTC2495 does not acknowledge its address until its conversion is
+  // done, so this also waits for that.
+  // Single-ended input: 1 0 1 SGL ODD A2 A1 A0
+  uint8_t channel_byte = 0xB0 | ((next_channel & 1) << 3) | (next_channel >> 1);
+  unsigned long start_millis = millis();
+  while (true){
+    Wire.beginTransmission(_ltc2495_address);
+    Wire.write(channel_byte);
+    Wire.write(LTC2495_CONFIG);
+    if (Wire.endTransmission(false) == 0){
+      break;
+    }
+    if ((millis() - start_millis) > LTC2495_TIMEOUT_MS){
+      return false;
+    }
+    delay(1);
+  }
+  if (Wire.requestFrom(_ltc2495_address, (uint8_t)3) != 3){
+    return false;
+  }
+  uint32_t raw = Wire.read();
+  raw = (raw << 8) | Wire.read();
+  raw = (raw << 8) | Wire.read();
+  // Offset binary: 0x800000 is 0 V, +/-0x400000 is +/- full scale
+  previous_code = (int32_t)raw - 0x800000L;
+  return true;
+}
+
+bool ALog::ltc2495_scan(const uint8_t channels[], uint8_t n, float volts[]){
+  // Convert each channel in turn, pipelined, and return their voltages.
+  // The reference channel is converted too, if it has not been already
+  // this logging event. Voltages are -9999 if the ADC does not respond.
+  rail_on(RAIL_REF_1V8, LTC2495_REFERENCE_WARMUP_MS);
+  bool measure_reference = (_ltc2495_reference_code == 0);
+  uint8_t nconversions = n + measure_reference;
+  int32_t code;
+  bool ok = true;
+  if (nconversions > 0){
+    // Start the first conversion; the result that comes back is stale
+    ok = ltc2495_transfer((n > 0) ? channels[0] : LTC2495_REFERENCE_CHANNEL, \
+                          code);
+  }
+  for (uint8_t i=0; ok && i<nconversions; i++){
+    uint8_t next_channel = (i+1 < n) ? channels[i+1] : \
+                           LTC2495_REFERENCE_CHANNEL;
+    ok = ltc2495_transfer(next_channel, code);
+    if (i < n){
+      volts[i] = code; // Exact: codes are within float's 24-bit mantissa
+    }
+    else {
+      _ltc2495_reference_code = code;
+    }
+  }
+  rail_off(RAIL_REF_1V8);
+  if (!ok || _ltc2495_reference_code <= 0){
+    _ltc2495_reference_code = 0;
+    for (uint8_t i=0; i<n; i++){
+      volts[i] = -9999;
+    }
+    return false;
+  }
+  for (uint8_t i=0; i<n; i++){
+    volts[i] = LTC2495_REFERENCE_VOLTAGE * volts[i] / _ltc2495_reference_code;
+  }
+  return true;
+}
+
+float ALog::LTC2495_voltage(uint8_t channel){
+  /**
+   * @brief
+   * Voltage on one channel of the LTC2495 external ADC (ALog BottleLogger v3)
+   *
+   * @details
+   * Reference-compensated against the 1.8 V precision reference, which is
+   * turned on for the conversion. Nothing is recorded: this is for use in
+   * your own calculations. Returns -9999 if the ADC does not respond.
+   *
+   * @param channel LTC2495 channel, 0-15 [-]
+   *
+   * Example:
+   * ```
+   * float V = alog.LTC2495_voltage(3);
+   * ```
+   */
+  float V;
+  ltc2495_scan(&channel, 1, &V);
+  return V;
+}
+
+void ALog::LTC2495_voltages(uint16_t channel_mask){
+  /**
+   * @brief
+   * Record the voltages on several channels of the LTC2495 external ADC
+   * (ALog BottleLogger v3)
+   *
+   * @details
+   * The channels are converted back-to-back, each one programmed while the
+   * previous result is read, so a scan takes about one conversion time
+   * (~150 ms) per channel. Voltages are reference-compensated against the
+   * 1.8 V precision reference, and written to five decimal places [V].
+   *
+   * @param channel_mask One bit per channel: bit 0 is channel 0 [-]
+   *
+   * Example:
+   * ```
+   * // Channels 0, 1, and 4
+   * alog.LTC2495_voltages(0b0000000000010011);
+   * ```
+   */
+  uint8_t channels[16];
+  float volts[16];
+  uint8_t n = 0;
+  for (uint8_t channel=0; channel<16; channel++){
+    if (channel_mask & (1 << channel)){
+      channels[n] = channel;
+      n++;
+    }
+  }
+  ltc2495_scan(channels, n, volts);
+
+  ///////////////
+  // SAVE DATA //
+  ///////////////
+
+  for (uint8_t i=0; i<n; i++){
+    if (first_log_after_booting_up){
+      headerfile.print(F("LTC2495 channel "));
+      headerfile.print(channels[i]);
+      headerfile.print(F(" voltage [V]"));
+      headerfile.print(F(","));
+      headerfile.sync();
+    }
+
+    write_value(volts[i], 5);
+  }
+}
+
+void ALog::vdivR_LTC2495(uint8_t channel, float Rref, float Vexcite, \
+           bool Rref_on_GND_side){
+  /**
+   * @brief
+   * Resistance from a simple voltage divider, read by the LTC2495 external
+   * ADC (ALog BottleLogger v3)
+   *
+   * @param channel LTC2495 channel, 0-15 [-]
+   *
+   * @param Rref Resistance value of reference resistor [ohms]
+   *
+   * @param Vexcite Voltage across the whole voltage divider [V]
+   *
+   * @param Rref_on_GND_side indicates the configuration of the voltage
+   * divider; see vdivR().
+   *
+   * @details
+   * Example:
+   * ```
+   * alog.vdivR_LTC2495(2, 10000);
+   * ```
+   */
+  float V = LTC2495_voltage(channel);
+  float _R = -9999;
+  if (V != -9999){
+    _R = vdiv_resistance(V/Vexcite, Rref, Rref_on_GND_side);
+  }
+  record_resistance(_R);
+}
 
+float ALog::thermistorB_LTC2495(float R0, float B, float Rref, float T0degC, \
+            uint8_t channel, float Vexcite, bool Rref_on_GND_side, \
+            bool record_results){
+  /**
+   * @brief
+   * Thermistor temperature, read by the LTC2495 external ADC (ALog
+   * BottleLogger v3)
+   *
+   * @details
+   * Same as thermistorB(), but with a single high-resolution conversion in
+   * place of oversampling.
+   *
+   * @param channel LTC2495 channel, 0-15 [-]
+   *
+   * @param Vexcite Voltage across the whole voltage divider [V]
+   *
+   * See thermistorB() for the other parameters.
+   *
+   * Example:
+   * ```
+   * // Cantherm from Digikey, 30 kOhm reference resistor, on channel 2
+   * alog.thermistorB_LTC2495(10000, 3950, 30000, 25, 2);
+   * ```
+   */
+  float V = LTC2495_voltage(channel);
+  float Rtherm = -9999;
+  if (V != -9999){
+    Rtherm = vdiv_resistance(V/Vexcite, Rref, Rref_on_GND_side);
+  }
+  return thermistorB_temperature(Rtherm, R0, B, T0degC, record_results);
+}
+
+float ALog::Honeywell_HSC_LTC2495(uint8_t channel, float Vsupply, float Pmin, \
+            float Pmax, int TransferFunction_number, int units){
+  /**
+   * @brief
+   * Honeywell HSC pressure sensor, read by the LTC2495 external ADC (ALog
+   * BottleLogger v3)
+   *
+   * @details
+   * Same as Honeywell_HSC_analog(), but with a single high-resolution
+   * conversion in place of oversampling; no ADC reference voltage is needed.
+   *
+   * @param channel LTC2495 channel, 0-15 [-]
+   *
+   * See Honeywell_HSC_analog() for the other parameters.
+   *
+   * Example:
+   * ```
+   * alog.Honeywell_HSC_LTC2495(1, 5, 0, 30, 1, 6);
+   * ```
+   */
+  return Honeywell_HSC_pressure(LTC2495_voltage(channel), Vsupply, Pmin, \
+                                Pmax, TransferFunction_number, units);
 }
 
 /*
@@ -3951,20 +6472,14 @@ void ALog::linearPotentiometer(uint8_t linpotPin, float Rref, float slope, \
   ///////////////
 
   if (first_log_after_booting_up){
-    headerfile.print("Distance [");
+    headerfile.print(F("Distance ["));
     headerfile.print(_distance_units);
-    headerfile.print("]");
-    headerfile.print(",");
+    headerfile.print(F("]"));
+    headerfile.print(F(","));
     headerfile.sync();
   }
 
-  // SD write
-  datafile.print(_dist);
-  datafile.print(F(","));
-
-  // Echo to serial
-  Serial.print(_dist);
-  Serial.print(F(","));
+  write_value(_dist, 2);
 
 }
 
@@ -4219,10 +6734,9 @@ void ALog::startup_sequence(){
     delay(1000);
   }
 
-  digitalWrite(SensorPowerPin, LOW);
-  digitalWrite(EXT_3V3, HIGH);
-  digitalWrite(EXT_5V0, LOW);
-  digitalWrite(REF_1V8, LOW);
+  for (uint8_t i=0; i<N_RAILS; i++){
+    rail_write(i, false);
+  }
 }
 
 void ALog::clockSet(){
@@ -4249,6 +6763,7 @@ void ALog::clockSet(){
 	Clock.setHour(Hour);
 	Clock.setMinute(Minute);
 	Clock.setSecond(Second);
+	_rtc_cache_valid = false;
 
 	// Give time at next five seconds
 	// Should use a DateTime object for this, b/c rollover is a potential
@@ -4335,7 +6850,7 @@ void ALog::GetDateStuff(byte& Year, byte& Month, byte& Day, byte& DoW,
 // See https://forum.arduino.cc/index.php?topic=72739.0
 // and https://forum.arduino.cc/index.php?topic=348562.0
 void _internalDateTime(uint16_t* date, uint16_t* time) {
-  DateTime now = RTC.now();
+  DateTime now = _rtcNow();
   // return date using FAT_DATE macro to format fields
   *date = FAT_DATE(now.year(), now.month(), now.day());
   // return time using FAT_TIME macro to format fields
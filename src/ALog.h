@@ -71,6 +71,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
                     // (This is for the program to configure each logger)
 #include <SoftwareSerial.h>
 
+// Parts of ALog that do not need the hardware (see ALogCore.h)
+#include <ALogCore.h>
+
 // Sensor-centric libraries
 #include <SFE_BMP180.h>
 //#include <Adafruit_Sensor.h>
@@ -78,13 +81,118 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //#include <eRCaGuy_NewAnalogRead.h>
 //#include <AtlasNW.h>
 
+// SDI-12: 1200 bps; longest response is to a concurrent data command
+#define SDI12_BIT_MICROSECONDS 833UL
+#define SDI12_MAX_RESPONSE_LENGTH 75
+
+// Steps of a BMP180 measurement; see ALog::Barometer_BMP180_start()
+#define BMP180_IDLE 0
+#define BMP180_CONVERTING_TEMPERATURE 1
+#define BMP180_CONVERTING_PRESSURE 2
+#define BMP180_FINISHED 3
+
+
+// Supply voltage watch, for ALog::set_battery_thresholds()
+#define ALOG_BANDGAP_VOLTAGE 1.1 // Nominal; each chip is within 10%
+#define ALOG_BATTERY_DIVIDER 0.1 // Battery voltage divider on the v3 board
+#define ALOG_AREF_NOMINAL_VOLTAGE 3.3 // Supply measured without a divider
+#define ALOG_AREF_WARMUP_MS 5 // AREF (3V3 sensor rail) settling time
+#define ALOG_BATTERY_HYSTERESIS_V 0.1 // Extra voltage to leave a low state
+#define ALOG_BATTERY_OK 0
+#define ALOG_BATTERY_LOW 1 // Optional sensors skipped
+#define ALOG_BATTERY_CRITICAL 2 // Logging interval stretched too
+
+// DS3231 real-time clock
+#define DS3231_ADDRESS 0x68
+#define DS3231_ALARM1_REGISTER 0x07 // Alarm 1, alarm 2, control, status
+#define DS3231_CONTROL_REGISTER 0x0E
+#define DS3231_CONTROL_DEFAULT 0x1C // Power-on value
+
+// LTC2495 16-channel external ADC (ALog BottleLogger v3)
+#define LTC2495_ADDRESS 0x45
+#define LTC2495_REFERENCE_CHANNEL 15 // Wired to REF_1V8
+#define LTC2495_REFERENCE_VOLTAGE 1.8
+#define LTC2495_REFERENCE_WARMUP_MS 5
+// Single-ended channel, 50/60 Hz rejection, 1x speed (~149 ms conversions)
+#define LTC2495_CONFIG 0x80
+#define LTC2495_TIMEOUT_MS 200
+
 // Outside of class definitions
 void wakeUpNow();
 void wakeUpNow_tip();
 void _ISR_void();
 void _anemometer_count_increment();
+void _wind_accumulator_edge();
+void _wind_accumulator_level();
+void _rain_accumulator_edge();
+void _rain_accumulator_level();
+void _accumulators_watchdog_tick(); // For a sketch's own ISR(WDT_vect)
+void _accumulators_watchdog_period(bool fast);
 void _internalDateTime(uint16_t* date, uint16_t* time); // Callback: SD DT stamp
 
+// One line of data, assembled as it is recorded and then written at once:
+// to the data file (or raw.txt, or nowhere, for aggregated or binary data)
+// and to serial. A line too long for the buffer is written in pieces, and
+// this is noted in header.txt. See ALog::set_line_buffer_length().
+#ifndef ALOG_LINE_BUFFER_LENGTH
+#define ALOG_LINE_BUFFER_LENGTH 128 // Characters, including the line end
+#endif
+class ALogLineBuffer : public Print {
+
+  public:
+    ALogLineBuffer();
+    bool set_length(uint16_t length);
+    void begin(Print *file);
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+    void commit(); // Ends the line and writes it
+    bool overflowed(); // Whether any line has been written in pieces
+    uint16_t longest_line(); // Characters, including the line end
+
+  private:
+    void drain();
+    char *_text;
+    uint16_t _size;
+    uint16_t _length;
+    uint16_t _line_length;
+    uint16_t _longest_line;
+    bool _overflowed;
+    Print *_file;
+
+};
+
+// Sensor power rails, for ALog::rail_on() and rail_off(); combine with "|"
+#define N_RAILS 3
+#define RAIL_3V3 0x01 // SensorPowerPin (v2) or EXT_3V3 (v3)
+#define RAIL_5V0 0x02 // EXT_5V0 (v3)
+#define RAIL_REF_1V8 0x04 // REF_1V8 (v3)
+#define RAIL_ALL 0x07
+
+// Sensors that can be read together by ALog::run_scheduled_sensors()
+#define ALOG_MAX_SCHEDULED_SENSORS 3 // Ultrasonic: ~90 bytes of heap when run
+#define ALOG_TASK_BMP180 0
+#define ALOG_TASK_MAXBOTIX_HRXL_ANALOG 1
+#define ALOG_TASK_MAXBOTIX_1CM_ANALOG 2
+
+// Parameters of a scheduled sensor, kept from scheduling until it is read
+struct ALogScheduledSensor {
+  uint8_t type;
+  uint8_t pin;
+  uint8_t Ex;
+  uint8_t n;
+  uint8_t rails; // Power rails needed, if managed by the scheduler
+  uint16_t warmup_ms;
+};
+
+// Working state of an analog ultrasonic burst run by the scheduler
+struct ALogUltrasonicBurst {
+  ALogStats range_stats;
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+  uint8_t npulses; // Excitation pulses so far, including 2 to clear junk
+  unsigned long next_millis; // When the current ping can be read
+};
+
 // The rest of the library
 class ALog {
 
@@ -107,6 +215,8 @@ class ALog {
     void endAnalog(); // DEPRECATED
     void sensorPowerOn();
     void sensorPowerOff();
+    void rail_on(uint8_t rails, uint16_t warmup_ms=0);
+    void rail_off(uint8_t rails);
 
     // Getters and setters
     bool get_use_sleep_mode();
@@ -117,16 +227,31 @@ class ALog {
     void set_REF_1V8(int8_t _pin);
     void set_RTCpowerPin(int8_t _pin);
     void set_SensorPowerPin(int8_t _pin);
+    void set_I2C_clock(uint32_t Hz);
+    void set_subsecond_timestamps(bool on);
+    void set_aggregation(uint32_t window_seconds, uint8_t nvalues, \
+         bool keep_raw=false);
+    void set_binary_output();
+    void set_line_buffer_length(uint16_t characters);
+    void set_ultrasonic_estimator(uint8_t estimator);
+    void set_ultrasonic_adaptive(float target_standard_error_mm, \
+         uint8_t min_pings=3);
     // Important subset: EEPROM: Serial number and calibrations
     uint16_t get_serial_number();
     float get_3V3_measured_voltage();
     float get_5V_measured_voltage();
+    // Memory use
+    uint16_t get_min_free_ram();
 
     // Sensors - standard procedure (wake up, log, sleep)
 void record(int integer, String header, int base);
 void record(int integer, String header);
 void record(float floatingpoint, String header);
 void record(String _string, String header);
+void record(int integer, const __FlashStringHelper* header, int base);
+void record(int integer, const __FlashStringHelper* header);
+void record(float floatingpoint, const __FlashStringHelper* header);
+void record(String _string, const __FlashStringHelper* header);
 
     float readPin(uint8_t pin);
     void readPins();
@@ -146,6 +271,8 @@ void record(String _string, String header);
     void maxbotixHRXL_WR_analog(uint8_t nping=10, uint8_t sonicPin=A0,
          uint8_t EX=99, bool writeAll=true, uint8_t ADC_resolution_nbits=10);
     void Decagon5TE(uint8_t excitPin, uint8_t dataPin); // Poorly-tested
+    void SDI12_concurrent(uint8_t dataPin, const char* addresses, \
+         uint8_t nvalues);
     void DecagonGS1(uint8_t pin, float Vref, uint8_t ADC_resolution_nbits=14);
     void vdivR(uint8_t pin, float Rref, uint8_t ADC_resolution_nbits=10, \
          bool Rref_on_GND_side=true);
@@ -165,20 +292,57 @@ void record(String _string, String header);
          uint8_t ADC_resolution_nbits=14);
     void Anemometer_reed_switch(uint8_t interrupt_pin_number,
          unsigned long reading_duration_milliseconds, \
+         float meters_per_second_per_rotation, bool record_gust=false);
+    void Anemometer_reed_switch_accumulate(uint8_t interrupt_pin_number, \
          float meters_per_second_per_rotation);
     void Wind_Vane_Inspeed(uint8_t vanePin);
     void Pyranometer(uint8_t analogPin, float raw_mV_per_W_per_m2, \
          float gain, float V_ref, uint8_t ADC_resolution_nbits=14);
     void Barometer_BMP180();
+    void Barometer_BMP180_start();
+    bool Barometer_BMP180_poll();
+    // LTC2495 external ADC (v3): reference-compensated channels [V]
+    float LTC2495_voltage(uint8_t channel);
+    void LTC2495_voltages(uint16_t channel_mask);
+    void vdivR_LTC2495(uint8_t channel, float Rref, float Vexcite=3.3, \
+         bool Rref_on_GND_side=true);
+    float thermistorB_LTC2495(float R0, float B, float Rref, float T0degC, \
+          uint8_t channel, float Vexcite=3.3, bool Rref_on_GND_side=true, \
+          bool record_results=true);
+    float Honeywell_HSC_LTC2495(uint8_t channel, float Vsupply, float Pmin, \
+          float Pmax, int TransferFunction_number, int units);
     void _sensor_function_template(uint8_t pin, float param1, \
          float param2, uint8_t ADC_bits=14, bool flag=false);
 
+    // Sensors - read together, overlapping their waits
+    void schedule_Barometer_BMP180();
+    void schedule_maxbotixHRXL_WR_analog(uint8_t nping=10, uint8_t sonicPin=A0, \
+         uint8_t EX=99);
+    void schedule_ultrasonicMB_analog_1cm(uint8_t nping, uint8_t Ex, \
+         uint8_t sonicPin);
+    void set_scheduled_sensor_power(uint8_t rails, uint16_t warmup_ms);
+    void run_scheduled_sensors();
+
+    // Event-triggered burst logging
+    void set_trigger(float threshold_on, float threshold_off, \
+         float rate_limit_per_second, uint16_t burst_interval_seconds);
+    bool trigger(float value);
+
+    // Supply voltage and battery saving
+    void set_battery_thresholds(float low_volts, float critical_volts, \
+         uint8_t interval_multiplier=4);
+    float measure_supply_voltage();
+    bool optional_sensors_enabled();
+
     // Sensors - triggered
     // Camera on/off function; decision made in end-user Arduino script
     void HackHD(int control_pin, bool want_camera_on);
     float Honeywell_HSC_analog(int pin, float Vsupply, float Vref, \
           float Pmin, float Pmax, int TransferFunction_number, int units, \
           uint8_t ADC_resolution_nbits=14);
+    // Rain gauge counted in the background and reported each log
+    void TippingBucketRainGage_accumulate(uint8_t interrupt_pin_number, \
+         float mm_per_tip);
 
   private:
     void pinUnavailable(uint8_t pin);
@@ -190,6 +354,9 @@ void record(String _string, String header);
     // wakeUpNow defined outside of class; see above
     void alarm(uint8_t hourInterval, uint8_t minInterval, \
          uint8_t secInterval);
+    void alarm_aligned(uint32_t unixtime_now, uint32_t interval_seconds, \
+         uint8_t min_lead_seconds);
+    void record_trigger(float value, float rate);
     void displayAlarms(); //debug tool delete if desired.
     void checkAlarms();  //debug tool delete if desired.
     void displayTime();   //debug tool delete if desired.
@@ -210,6 +377,11 @@ void record(String _string, String header);
     void establishContact_Tx();
     bool establishContact_Rx();
 
+    // Sensor power rails
+    void rails_up(uint8_t rails);
+    bool rails_warm(uint8_t rails, uint16_t warmup_ms);
+    void rail_write(uint8_t rail_index, bool on);
+
     // Clock and SD card power
     void SDon_RTCon();
     void SDoff_RTCsleep();
@@ -222,14 +394,39 @@ void record(String _string, String header);
     // Sensor utility codes
     float _vdivR(uint8_t pin, float Rref, uint8_t adc_bits=10, \
           bool Rref_on_GND_side=true, bool oversample_debug=false);
+    float vdiv_resistance(float ratio, float Rref, bool Rref_on_GND_side);
+    float thermistorB_temperature(float Rtherm, float R0, float B, \
+          float T0degC, bool record_results);
+    void record_resistance(float _R);
+    float Honeywell_HSC_pressure(float Vout, float Vsupply, float Pmin, \
+          float Pmax, int TransferFunction_number, int units);
+    // LTC2495 external ADC
+    bool ltc2495_transfer(uint8_t next_channel, int32_t &previous_code);
+    bool ltc2495_scan(const uint8_t channels[], uint8_t n, float volts[]);
     // I don't trust the software serial version -- should do some lab testing
     // to make sure that chances of clock speed / interrupt problems,
     // especially with so much time in sleep mode, are near-0.
     //int maxbotix_soft_Serial_parse(int Ex, int Rx, bool RS232=false);
     int maxbotix_Serial_parse(uint8_t Ex);
-    float standard_deviation_from_array(float values[], int nvalues, \
-          float mean);
-    float standard_deviation_from_array(int values[], int nvalues, float mean);
+    void excitation_pulse(uint8_t pin, uint16_t microseconds);
+    float ultrasonic_estimate(float recent_ranges[], ALogStats &range_stats);
+    void ultrasonic_estimate_header(const char* units);
+    bool ultrasonic_burst_converged(ALogStats &range_stats, float mm_per_unit);
+    void record_ultrasonic(float estimated_range, ALogStats &range_stats, \
+         const char* units);
+
+    // Cooperative scheduler
+    void schedule_sensor(uint8_t type, uint8_t pin, uint8_t Ex, uint8_t n);
+    void ultrasonic_burst_start(ALogScheduledSensor &sensor, \
+         ALogUltrasonicBurst &burst);
+    void ultrasonic_burst_excite(ALogScheduledSensor &sensor, \
+         ALogUltrasonicBurst &burst);
+    bool ultrasonic_burst_poll(ALogScheduledSensor &sensor, \
+         ALogUltrasonicBurst &burst);
+    // SDI-12 bus master
+    uint8_t sdi12_command(uint8_t pin, const char* command, char* response);
+    void sdi12_write_char(uint8_t pin, char c);
+    int sdi12_read_char(uint8_t pin, uint16_t timeout_ms);
 
     // Special sensor codes
     // Rain gauge - will wake logger up and cause it to log to a different file
@@ -237,12 +434,29 @@ void record(String _string, String header);
     // This runs of bool _ext_int = true in loger.initialize()
     void TippingBucketRainGage();
 
+    // Background wind and rain accumulators
+    void accumulators_awake();
+    void accumulators_asleep();
+    void record_accumulators();
+
     // Logging
+    void header_label(const __FlashStringHelper* label);
     void start_logging_to_datafile();
     void start_logging_to_otherfile(char* filename);
     void end_logging_to_otherfile();
     void start_logging_to_headerfile();
+    void start_logging_to_rawfile();
+    void start_logging_to_binaryfile();
     void end_logging_to_headerfile();
+    void print_timestamp(Print &out);
+    void write_value(float value, uint8_t decimals);
+    void write_text(const String &text);
+    void print_float(Print &out, float value, uint8_t decimals);
+    float read_AREF_voltage();
+    uint8_t battery_state_at(float volts);
+    void record_supply_voltage();
+    void write_aggregates();
+    void write_binary_line();
     void endLine();
 
 };
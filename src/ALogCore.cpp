@@ -0,0 +1,600 @@
+/**
+@file ALogCore.cpp
+
+The parts of ALog that only compute; see ALogCore.h.
+
+# LICENSE: GNU GPL v3
+
+ALogCore.cpp is part of ALog, an Arduino library written by Andrew D.
+Wickert and Chad T. Sandell; see ALog.cpp for the full license.
+*/
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+// On a PC (test/host): no program memory
+#include <math.h>
+#include <string.h>
+#define PROGMEM
+#define PSTR(s) (s)
+#define strcpy_P strcpy
+#define pgm_read_float(address) (*(const float *)(address))
+#endif
+
+#include <ALogCore.h>
+
+
+// Fast float text
+////////////////////
+
+// Half of the last decimal place, as Print::printFloat() computes it by
+// repeated division, for rounding: these are those same float values
+const float FLOAT_TEXT_ROUNDING[FLOAT_TEXT_MAX_DECIMALS + 1] PROGMEM = {
+  0.5, 0.0500000007, 0.00499999989, 0.000499999966, 4.99999951e-05,
+  4.99999942e-06, 4.99999942e-07, 4.99999935e-08, 4.99999953e-09};
+
+uint8_t _formatFloat(char *text, float number, uint8_t decimals){
+  // Writes the same characters as Print::printFloat() (on AVR, where double
+  // is float) into text, which must hold FLOAT_TEXT_LENGTH characters, and
+  // returns how many. printFloat() takes a float multiplication, a float
+  // subtraction, and a print() call for each decimal place; this follows
+  // those float multiplications exactly, but in integer arithmetic on the
+  // mantissa, and prints nothing. Decimal places are limited to
+  // FLOAT_TEXT_MAX_DECIMALS.
+  char *p = text;
+  if (isnan(number)){
+    strcpy_P(text, PSTR("nan"));
+    return 3;
+  }
+  if (isinf(number)){
+    strcpy_P(text, PSTR("inf"));
+    return 3;
+  }
+  if (number > 4294967040.0 || number < -4294967040.0){
+    strcpy_P(text, PSTR("ovf"));
+    return 3;
+  }
+  if (number < 0.0){
+    *p++ = '-';
+    number = -number;
+  }
+  if (decimals > FLOAT_TEXT_MAX_DECIMALS){
+    decimals = FLOAT_TEXT_MAX_DECIMALS;
+  }
+  number += pgm_read_float(&FLOAT_TEXT_ROUNDING[decimals]);
+  uint32_t int_part = (uint32_t)number;
+  float remainder = number - (float)int_part;
+
+  // Integer part: digits are found last first
+  char digits[10];
+  uint8_t ndigits = 0;
+  do {
+    digits[ndigits++] = '0' + int_part % 10;
+    int_part /= 10;
+  } while (int_part > 0);
+  while (ndigits > 0){
+    *p++ = digits[--ndigits];
+  }
+  if (decimals == 0){
+    return p - text;
+  }
+  *p++ = '.';
+
+  // Decimal places. The remainder, in [0, 1), is mantissa / 2^shift
+  uint32_t bits;
+  memcpy(&bits, &remainder, sizeof(bits));
+  uint8_t exponent = bits >> 23;
+  uint32_t mantissa = bits & 0x7FFFFFUL;
+  uint8_t shift = 149;
+  if (exponent > 0){
+    mantissa |= 0x800000UL;
+    shift = 150 - exponent;
+  }
+  while (decimals-- > 0){
+    // Multiply by 10, then round to float's 24 significant bits (to the
+    // nearest, ties to even), as the float multiplication does
+    mantissa *= 10;
+    uint8_t excess = 0;
+    while ((mantissa >> excess) >= 0x1000000UL){
+      excess++;
+    }
+    if (excess > 0){
+      uint32_t dropped = mantissa & ((1UL << excess) - 1);
+      uint32_t half = 1UL << (excess - 1);
+      mantissa >>= excess;
+      shift -= excess;
+      if (dropped > half || (dropped == half && (mantissa & 1))){
+        mantissa++;
+      }
+    }
+    // The next digit is the integer part
+    uint8_t digit = 0;
+    if (shift < 32){
+      digit = mantissa >> shift;
+      mantissa -= (uint32_t)digit << shift;
+    }
+    if (digit > 9){
+      // Can only be 10, from rounding; printFloat() writes it as such
+      *p++ = '1';
+      digit -= 10;
+    }
+    *p++ = '0' + digit;
+  }
+  return p - text;
+}
+
+
+// Running statistics for bursts of readings
+//////////////////////////////////////////////
+
+// Welford's one-pass algorithm: each reading updates the mean and the sum
+// of squared deviations from it (M2), so nothing has to be stored and
+// no second pass is needed for the standard deviation.
+
+ALogStats::ALogStats(){
+  reset();
+}
+
+void ALogStats::reset(){
+  _n = 0;
+  _mean = 0;
+  _M2 = 0;
+  _min = 0;
+  _max = 0;
+  _median = 0;
+  _median_spread = 0;
+  _median_seeded = false;
+}
+
+void ALogStats::add(float x){
+  _n++;
+  float delta = x - _mean;
+  _mean += delta / _n;
+  _M2 += delta * (x - _mean);
+  if (_n == 1){
+    _min = x;
+    _max = x;
+    _median = x;
+  }
+  else {
+    if (x < _min){
+      _min = x;
+    }
+    if (x > _max){
+      _max = x;
+    }
+    // Stochastic-approximation median: step toward each new reading by an
+    // amount that scales with the spread of the data and shrinks as the
+    // burst goes on. Cannot be pulled farther than one step by an outlier.
+    // The spread is the running mean absolute deviation from the estimate,
+    // which (unlike the standard deviation) needs no sqrt per reading.
+    // Once seeded, an outlier can only widen the spread a little, too.
+    float deviation = fabs(x - _median);
+    if (_median_seeded && _median_spread > 0 && \
+        deviation > 3 * _median_spread){
+      deviation = 3 * _median_spread;
+    }
+    _median_spread += (deviation - _median_spread) / (_n - 1);
+    float step = 2.5 * _median_spread / _n;
+    if (x > _median){
+      _median += step;
+      if (_median > x){
+        _median = x;
+      }
+    }
+    else if (x < _median){
+      _median -= step;
+      if (_median < x){
+        _median = x;
+      }
+    }
+  }
+}
+
+uint16_t ALogStats::count(){
+  return _n;
+}
+
+float ALogStats::mean(){
+  return _mean;
+}
+
+float ALogStats::variance(){
+  if (_n == 0){
+    return 0;
+  }
+  return _M2 / _n;
+}
+
+float ALogStats::standard_deviation(){
+  return sqrt(variance());
+}
+
+float ALogStats::minimum(){
+  return _min;
+}
+
+float ALogStats::maximum(){
+  return _max;
+}
+
+float ALogStats::median_estimate(){
+  return _median;
+}
+
+void ALogStats::seed_median(float median, float spread){
+  // Restart the streaming median from a better one, e.g., the exact median
+  // of the first few readings. The streaming estimate alone starts at the
+  // first reading, which may be an outlier.
+  _median = median;
+  _median_spread = spread;
+  _median_seeded = true;
+}
+
+
+// Estimators for bursts of ultrasonic pings
+///////////////////////////////////////////////
+
+void _sortSmallArray(float values[], uint8_t n){
+  // Insertion sort: small and fast for the few values in a burst buffer
+  float value;
+  int8_t j;
+  for (uint8_t i=1; i<n; i++){
+    value = values[i];
+    for (j=i-1; j>=0 && values[j] > value; j--){
+      values[j+1] = values[j];
+    }
+    values[j+1] = value;
+  }
+}
+
+void _ultrasonicAddPing(float range, float recent_ranges[], \
+                        ALogStats &range_stats){
+  // Add a ping to the statistics and to the most recent pings. When the
+  // buffer of recent pings is first full, its exact median (and its MAD,
+  // scaled to a mean absolute deviation for normally-distributed noise)
+  // seed the streaming median, which is used for longer bursts.
+  range_stats.add(range);
+  recent_ranges[(range_stats.count() - 1) % ULTRASONIC_ROBUST_BUFFER_SIZE] = \
+      range;
+  if (range_stats.count() == ULTRASONIC_ROBUST_BUFFER_SIZE){
+    const uint8_t n = ULTRASONIC_ROBUST_BUFFER_SIZE;
+    float sorted[ULTRASONIC_ROBUST_BUFFER_SIZE];
+    memcpy(sorted, recent_ranges, sizeof(sorted));
+    _sortSmallArray(sorted, n);
+    float median = (sorted[(n-1)/2] + sorted[n/2]) / 2.;
+    for (uint8_t i=0; i<n; i++){
+      sorted[i] = fabs(sorted[i] - median);
+    }
+    _sortSmallArray(sorted, n);
+    float MAD = (sorted[(n-1)/2] + sorted[n/2]) / 2.;
+    range_stats.seed_median(median, 1.183 * MAD);
+  }
+}
+
+float _ultrasonicEstimate(uint8_t estimator, float recent_ranges[], \
+                          ALogStats &range_stats){
+  // Distance from a burst of pings, using one of the ULTRASONIC_...
+  // estimators. recent_ranges holds the most recent
+  // ULTRASONIC_ROBUST_BUFFER_SIZE pings (in any order); it is sorted here.
+  uint8_t n = ULTRASONIC_ROBUST_BUFFER_SIZE;
+  if (range_stats.count() < n){
+    n = range_stats.count();
+  }
+  if (estimator == ULTRASONIC_MEAN || n == 0){
+    return range_stats.mean();
+  }
+  _sortSmallArray(recent_ranges, n);
+  float median = (recent_ranges[(n-1)/2] + recent_ranges[n/2]) / 2.;
+  float sum = 0;
+  uint8_t nkept = 0;
+  if (estimator == ULTRASONIC_TRIMMED_MEAN){
+    for (uint8_t i=n/4; i<n-n/4; i++){
+      sum += recent_ranges[i];
+      nkept++;
+    }
+    return sum / nkept;
+  }
+  else if (estimator == ULTRASONIC_MAD_FILTERED_MEAN){
+    // Median absolute deviation, scaled to match a standard deviation for
+    // normally-distributed noise; keep pings within 3 of these of the median
+    float deviations[ULTRASONIC_ROBUST_BUFFER_SIZE];
+    for (uint8_t i=0; i<n; i++){
+      deviations[i] = fabs(recent_ranges[i] - median);
+    }
+    _sortSmallArray(deviations, n);
+    float MAD = (deviations[(n-1)/2] + deviations[n/2]) / 2.;
+    float threshold = 3. * 1.4826 * MAD;
+    for (uint8_t i=0; i<n; i++){
+      if (fabs(recent_ranges[i] - median) <= threshold){
+        sum += recent_ranges[i];
+        nkept++;
+      }
+    }
+    // At least half of the pings are within 1 MAD, so nkept > 0
+    return sum / nkept;
+  }
+  // ULTRASONIC_MEDIAN: exact for a burst that fits in the buffer; for a
+  // longer one, the streaming estimate uses every ping, not just the last few
+  if (range_stats.count() > ULTRASONIC_ROBUST_BUFFER_SIZE){
+    return range_stats.median_estimate();
+  }
+  return median;
+}
+
+bool _ultrasonicConverged(ALogStats &range_stats, float mm_per_unit, \
+                          float target_standard_error_mm, uint8_t min_pings){
+  // True if target_standard_error_mm > 0, at least min_pings pings have been
+  // taken, and the standard error of the mean is below the target. Uses the
+  // sample (n-1) variance: SEM^2 = (M2/n) / (n-1).
+  uint16_t n = range_stats.count();
+  if (target_standard_error_mm <= 0 || n < min_pings || n < 2){
+    return false;
+  }
+  float standard_error_mm = mm_per_unit * sqrt(range_stats.variance() / (n-1));
+  return standard_error_mm < target_standard_error_mm;
+}
+
+
+// Windowed statistics
+/////////////////////////
+
+// One ALogStats and number of decimal places for each value in the line,
+// allocated once. Values past nvalues are not counted; text is counted out,
+// so its columns have no readings.
+
+ALogAggregation::ALogAggregation(){
+  _stats = NULL;
+  _decimals = NULL;
+  _nvalues = 0;
+  _position = 0;
+  _window_seconds = 1;
+  _window = 0;
+  _have_data = false;
+}
+
+bool ALogAggregation::begin(uint32_t window_seconds, uint8_t nvalues){
+  end();
+  _stats = new ALogStats[nvalues];
+  _decimals = new uint8_t[nvalues];
+  if (_stats == NULL || _decimals == NULL){
+    end();
+    return false;
+  }
+  for (uint8_t i=0; i<nvalues; i++){
+    _decimals[i] = 0;
+  }
+  _nvalues = nvalues;
+  _window_seconds = (window_seconds > 0) ? window_seconds : 1;
+  _window = 0;
+  _have_data = false;
+  return true;
+}
+
+void ALogAggregation::end(){
+  delete[] _stats;
+  delete[] _decimals;
+  _stats = NULL;
+  _decimals = NULL;
+  _nvalues = 0;
+  _have_data = false;
+}
+
+bool ALogAggregation::active(){
+  return _stats != NULL;
+}
+
+bool ALogAggregation::window_ended(uint32_t unixtime){
+  return _have_data && (unixtime / _window_seconds != _window);
+}
+
+void ALogAggregation::start_line(uint32_t unixtime){
+  _window = unixtime / _window_seconds;
+  _position = 0;
+}
+
+void ALogAggregation::add(float value, uint8_t decimals){
+  if (_position < _nvalues){
+    if (value != -9999){
+      _stats[_position].add(value);
+      _have_data = true;
+    }
+    _decimals[_position] = decimals;
+  }
+  _position++;
+}
+
+void ALogAggregation::skip(){
+  _position++;
+}
+
+void ALogAggregation::clear(){
+  for (uint8_t i=0; i<_nvalues; i++){
+    _stats[i].reset();
+  }
+  _have_data = false;
+}
+
+uint8_t ALogAggregation::nvalues(){
+  return _nvalues;
+}
+
+uint32_t ALogAggregation::window_seconds(){
+  return _window_seconds;
+}
+
+uint32_t ALogAggregation::window_start(){
+  return _window * _window_seconds;
+}
+
+ALogStats &ALogAggregation::stats(uint8_t i){
+  return _stats[i];
+}
+
+uint8_t ALogAggregation::decimals(uint8_t i){
+  return _decimals[i];
+}
+
+
+// Compressed binary data stream
+///////////////////////////////////
+
+ALogBinaryEncoder::ALogBinaryEncoder(){
+  _line.nvalues = 0;
+  _previous.nvalues = 0;
+  _unixtime = 0;
+  _last_unixtime = 0;
+  _lines_in_block = 0;
+}
+
+void ALogBinaryEncoder::start_line(uint32_t unixtime){
+  _unixtime = unixtime;
+  _line.nvalues = 0;
+}
+
+void ALogBinaryEncoder::add(float value, uint8_t decimals){
+  if (_line.nvalues >= ALOG_BINARY_MAX_VALUES){
+    return;
+  }
+  // Fixed point, with the decimal places that would have been written
+  float scaled = value;
+  for (uint8_t i=0; i<decimals; i++){
+    scaled *= 10;
+  }
+  if (scaled > 2.0e9){
+    scaled = 2.0e9;
+  }
+  else if (scaled < -2.0e9){
+    scaled = -2.0e9;
+  }
+  _line.values[_line.nvalues] = lround(scaled);
+  _line.decimals[_line.nvalues] = decimals;
+  _line.nvalues++;
+}
+
+uint8_t ALogBinaryEncoder::end_line(uint8_t *out){
+  // out must hold ALOG_BINARY_LINE_BYTES
+  uint8_t length = 0;
+  bool new_block = (_lines_in_block == 0) || \
+      (_lines_in_block >= ALOG_BINARY_BLOCK_LINES) || \
+      (_line.nvalues != _previous.nvalues) || \
+      (_unixtime < _last_unixtime) || \
+      (memcmp(_line.decimals, _previous.decimals, _line.nvalues) != 0);
+  if (new_block){
+    length += _writeVarint(out + length, 1);
+    out[length++] = _line.nvalues;
+    memcpy(out + length, _line.decimals, _line.nvalues);
+    length += _line.nvalues;
+    length += _writeVarint(out + length, _unixtime);
+    for (uint8_t i=0; i<_line.nvalues; i++){
+      length += _writeVarint(out + length, _zigzag(_line.values[i]));
+    }
+    _lines_in_block = 1;
+  }
+  else {
+    length += _writeVarint(out + length, (_unixtime - _last_unixtime) << 1);
+    for (uint8_t i=0; i<_line.nvalues; i++){
+      // Wraps around, as in the decoder, if the difference is out of range
+      length += _writeVarint(out + length, \
+          _zigzag((int32_t)((uint32_t)_line.values[i] - \
+                            (uint32_t)_previous.values[i])));
+    }
+    _lines_in_block++;
+  }
+  _last_unixtime = _unixtime;
+  _previous = _line;
+  return length;
+}
+
+uint8_t _writeVarint(uint8_t *out, uint32_t value){
+  // 7 bits per byte, least significant first; the high bit is set on all
+  // but the last byte. Returns the number of bytes (at most 5).
+  uint8_t length = 0;
+  while (value >= 0x80){
+    out[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (uint8_t)value;
+  return length;
+}
+
+uint32_t _zigzag(int32_t value){
+  // Small negative numbers to small positive ones: 0, -1, 1, -2, ... to
+  // 0, 1, 2, 3, ..., so that they take few bytes as varints
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+// Decagon DDI serial frames
+//////////////////////////////
+
+// Checksum: sum of all characters from the <TAB> through the sensor type,
+// modulo 64, plus 32 (to make it printable). Anything before the <TAB> is
+// ignored, and a frame with anything other than digits and spaces in its
+// values is dropped to wait for the next <TAB> (which may be that
+// character: a frame cut short by the start of another).
+
+ALogDDIFrame::ALogDDIFrame(){
+  reset();
+}
+
+void ALogDDIFrame::reset(){
+  _state = DDI_WAIT_FOR_TAB;
+  _raw[0] = _raw[1] = _raw[2] = 0;
+  _nvalues = 0;
+  _in_value = false;
+  _checksum_sum = 0;
+  _good = false;
+}
+
+bool ALogDDIFrame::add(char c){
+  if (_state == DDI_WAIT_FOR_TAB){
+    if (c == '\t'){
+      _checksum_sum = c;
+      _state = DDI_VALUES;
+    }
+  }
+  else if (_state == DDI_VALUES){
+    _checksum_sum += c;
+    if (c >= '0' && c <= '9'){
+      if (!_in_value){
+        _in_value = true;
+        _nvalues++;
+      }
+      if (_nvalues <= 3){
+        _raw[_nvalues-1] = 10*_raw[_nvalues-1] + (c - '0');
+      }
+    }
+    else if (c == ' '){
+      _in_value = false;
+    }
+    else if (c == '\r'){
+      _state = DDI_SENSOR_TYPE;
+    }
+    else {
+      // Not a DDI frame; wait for the next one, which may start right here
+      reset();
+      return add(c);
+    }
+  }
+  else if (_state == DDI_SENSOR_TYPE){
+    _checksum_sum += c;
+    _state = DDI_CHECKSUM;
+  }
+  else if (_state == DDI_CHECKSUM){
+    _good = (c == (_checksum_sum % 64) + 32) && (_nvalues == 3);
+    _state = DDI_DONE;
+  }
+  return (_state == DDI_DONE);
+}
+
+bool ALogDDIFrame::good(){
+  return _good;
+}
+
+int ALogDDIFrame::value(uint8_t i){
+  if (i >= 3){
+    return 0;
+  }
+  return _raw[i];
+}
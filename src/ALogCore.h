@@ -0,0 +1,168 @@
+/**
+@file
+
+# ALogCore.h
+
+The parts of ALog that only compute: they use no pins, clock, or files, and
+so build without the Arduino core as well. test/host checks them on a PC.
+
+## LICENSE: GNU GPL v3
+
+ALogCore.h is part of ALog, an Arduino library written by Andrew D. Wickert
+and Chad T. Sandell; see ALog.h for the full license.
+*/
+
+#ifndef ALogCore_h
+#define ALogCore_h
+
+#include <stdint.h>
+
+// Float text, as written by Print::printFloat() (see _formatFloat())
+#define FLOAT_TEXT_MAX_DECIMALS 8
+#define FLOAT_TEXT_LENGTH (13 + FLOAT_TEXT_MAX_DECIMALS)
+
+uint8_t _formatFloat(char *text, float number, uint8_t decimals);
+
+// Estimators for the distance from a burst of ultrasonic pings;
+// see ALog::set_ultrasonic_estimator()
+#define ULTRASONIC_MEAN 0
+#define ULTRASONIC_MEDIAN 1
+#define ULTRASONIC_TRIMMED_MEAN 2
+#define ULTRASONIC_MAD_FILTERED_MEAN 3
+// Number of most recent pings kept for the robust (non-mean) estimators
+#define ULTRASONIC_ROBUST_BUFFER_SIZE 15
+
+// Running statistics for a burst of readings (e.g., ultrasonic pings).
+// Welford's method: one pass, constant memory, no matter how many readings
+// are added. Used by the burst-type sensor functions in place of arrays.
+class ALogStats {
+
+  public:
+    ALogStats();
+    void reset();
+    void add(float x);
+    uint16_t count();
+    float mean();
+    float variance(); // Population variance (divides by n)
+    float standard_deviation();
+    float minimum();
+    float maximum();
+    float median_estimate(); // Streaming estimate, not an exact median
+    void seed_median(float median, float spread);
+
+  private:
+    uint16_t _n;
+    float _mean;
+    float _M2;
+    float _min;
+    float _max;
+    float _median;
+    float _median_spread; // Mean absolute deviation from _median
+    bool _median_seeded;
+
+};
+
+void _sortSmallArray(float values[], uint8_t n);
+void _ultrasonicAddPing(float range, float recent_ranges[], \
+                        ALogStats &range_stats);
+float _ultrasonicEstimate(uint8_t estimator, float recent_ranges[], \
+                          ALogStats &range_stats);
+bool _ultrasonicConverged(ALogStats &range_stats, float mm_per_unit, \
+                          float target_standard_error_mm, uint8_t min_pings);
+
+// Statistics of each value in a line over windows of time; see
+// ALog::set_aggregation(). Each line starts with start_line(), and each of its
+// values, in order, goes to add() (numbers) or skip() (text). Before a line
+// that starts a new window, window_ended() is true: write the statistics of
+// the last window, then clear().
+class ALogAggregation {
+
+  public:
+    ALogAggregation();
+    bool begin(uint32_t window_seconds, uint8_t nvalues); // False: no RAM
+    void end();
+    bool active();
+    bool window_ended(uint32_t unixtime);
+    void start_line(uint32_t unixtime);
+    void add(float value, uint8_t decimals); // -9999 (no data) is counted out
+    void skip();
+    void clear();
+    uint8_t nvalues();
+    uint32_t window_seconds();
+    uint32_t window_start(); // UNIX time at which the window starts
+    ALogStats &stats(uint8_t i);
+    uint8_t decimals(uint8_t i);
+
+  private:
+    ALogStats *_stats;
+    uint8_t *_decimals;
+    uint8_t _nvalues;
+    uint8_t _position; // Of the next value in the line
+    uint32_t _window_seconds;
+    uint32_t _window;
+    bool _have_data;
+
+};
+
+// Compressed binary data stream (data.bin); see ALog::set_binary_output()
+// for the format. Each line starts with start_line(), each of its numbers
+// goes to add(), and end_line() encodes it, as a block start or as
+// differences from the line before.
+#define ALOG_BINARY_MAX_VALUES 16 // Values stored per line
+#define ALOG_BINARY_BLOCK_LINES 32 // Lines per block at most
+// Most bytes that one line can take: a block start with all values
+#define ALOG_BINARY_LINE_BYTES (2 + ALOG_BINARY_MAX_VALUES + 5 + \
+                                5 * ALOG_BINARY_MAX_VALUES)
+class ALogBinaryEncoder {
+
+  public:
+    ALogBinaryEncoder();
+    void start_line(uint32_t unixtime);
+    void add(float value, uint8_t decimals); // Past the last value: dropped
+    uint8_t end_line(uint8_t *out); // Returns the number of bytes in out
+
+  private:
+    struct Line {
+      uint8_t nvalues;
+      uint8_t decimals[ALOG_BINARY_MAX_VALUES];
+      int32_t values[ALOG_BINARY_MAX_VALUES];
+    };
+    Line _line;
+    Line _previous; // To take differences from
+    uint32_t _unixtime;
+    uint32_t _last_unixtime;
+    uint8_t _lines_in_block; // 0: the next line starts a block
+
+};
+
+uint8_t _writeVarint(uint8_t *out, uint32_t value);
+uint32_t _zigzag(int32_t value);
+
+// Decagon Devices DDI serial frame, as sent by the 5TE when powered:
+// <TAB>Epsilon_Raw Sigma_Raw T_Raw<CR><sensor type><checksum><CR><LF>
+// Read one character at a time with add(), as it arrives.
+#define DDI_WAIT_FOR_TAB 0
+#define DDI_VALUES 1
+#define DDI_SENSOR_TYPE 2
+#define DDI_CHECKSUM 3
+#define DDI_DONE 4
+class ALogDDIFrame {
+
+  public:
+    ALogDDIFrame();
+    void reset();
+    bool add(char c); // True once the frame has ended, good or not
+    bool good(); // Complete, with 3 values, and the checksum matches
+    int value(uint8_t i); // Epsilon_Raw, Sigma_Raw, T_Raw; 0 if missing
+
+  private:
+    uint8_t _state;
+    int _raw[3];
+    uint8_t _nvalues; // Number of values started
+    bool _in_value;
+    uint16_t _checksum_sum;
+    bool _good;
+
+};
+
+#endif
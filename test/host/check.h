@@ -0,0 +1,30 @@
+// Checks for the host tests: each failure is printed, and main() returns
+// the number of failures (0: all passed)
+
+#ifndef check_h
+#define check_h
+
+#include <stdio.h>
+
+static int _failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)){ \
+      printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+      _failures++; \
+    } \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+  do { \
+    double _a = (a); \
+    double _b = (b); \
+    if (!(_a - _b <= (tolerance) && _b - _a <= (tolerance))){ \
+      printf("%s:%d: failed: %s = %.9g, %s = %.9g\n", __FILE__, __LINE__, \
+             #a, _a, #b, _b); \
+      _failures++; \
+    } \
+  } while (0)
+
+#endif
@@ -0,0 +1,269 @@
+// Simulates one logging event, on a millisecond clock, two ways:
+// * Blocking: each sensor is switched on, warmed up, read, and switched off
+//   in turn, as with rail_on(), the blocking sensor function, and rail_off()
+// * Scheduled: as ALog::run_scheduled_sensors(): every rail is switched on
+//   at once, each sensor starts once its own warm-up has passed, all are
+//   polled in turn, and each rail is switched off once its sensors finish
+// and reports the time awake and the time that the sensor rails are on.
+// Sensors that cannot be scheduled (serial, Decagon, SDI-12) run one after
+// another in both cases, so they are included to show the overall saving.
+//
+// Timings: a BMP180 conversion is 5 ms (temperature) then 26 ms (pressure,
+// highest resolution); an analog MaxBotix burst is 2 pings to clear out
+// junk, then one per reading, 1 ms pulse + 100 ms each, stopping early (with
+// set_ultrasonic_adaptive(1, 3)) once the standard error is below 1 mm.
+
+#include <math.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+// Deterministic noise, so that every run simulates the same pings
+static uint32_t random_state;
+
+static float uniform(){
+  random_state = random_state * 1664525UL + 1013904223UL;
+  return ((random_state >> 8) + 0.5f) / 16777216.f;
+}
+
+static float gaussian(float mean, float standard_deviation){
+  return mean + standard_deviation * sqrtf(-2.f * logf(uniform())) * \
+         cosf(6.2831853f * uniform());
+}
+
+// As in ALog.h
+#define N_RAILS 3
+#define ALOG_MAX_SCHEDULED_SENSORS 3
+
+#define BMP180 0
+#define ULTRASONIC 1
+#define UNSCHEDULABLE 2 // Fixed duration; runs on its own
+
+struct Sensor {
+  const char *name;
+  uint8_t type;
+  uint8_t rails;
+  uint16_t warmup_ms;
+  uint8_t npings; // Ultrasonic: the most pings
+  float noise_mm; // Ultrasonic: noise in each ping
+  uint16_t duration_ms; // Unschedulable: time to read
+};
+
+struct Event {
+  uint32_t awake_ms;
+  uint32_t rail_on_ms; // Summed over the rails
+};
+
+// Working state of a simulated sensor, as the scheduler keeps it
+struct Running {
+  uint8_t state;
+  uint32_t next_ms; // When the current step ends
+  uint8_t step; // BMP180: conversion; ultrasonic: pulses so far
+  ALogStats stats;
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+};
+
+#define WARMING_UP 0
+#define RUNNING 1
+#define DONE 2
+
+static void start(const Sensor &sensor, Running &run, uint32_t now){
+  run.step = 0;
+  run.stats.reset();
+  if (sensor.type == BMP180){
+    run.next_ms = now + 5;
+  }
+  else {
+    run.next_ms = now + 101;
+    run.step = 1;
+  }
+}
+
+static bool poll(const Sensor &sensor, Running &run, uint32_t now){
+  // As Barometer_BMP180_poll() and ultrasonic_burst_poll()
+  if (now < run.next_ms){
+    return false;
+  }
+  if (sensor.type == BMP180){
+    if (run.step == 0){
+      run.step = 1;
+      run.next_ms = now + 26;
+      return false;
+    }
+    return true;
+  }
+  if (run.step > 2){
+    _ultrasonicAddPing(gaussian(1500, sensor.noise_mm), run.recent_ranges, \
+                       run.stats);
+    if (run.stats.count() >= sensor.npings || \
+        _ultrasonicConverged(run.stats, 1., 1., 3)){
+      return true;
+    }
+  }
+  run.step++;
+  run.next_ms = now + 101;
+  return false;
+}
+
+static uint32_t run_alone(const Sensor &sensor, uint32_t now){
+  // A blocking sensor function: returns when it has finished
+  if (sensor.type == UNSCHEDULABLE){
+    return now + sensor.duration_ms;
+  }
+  Running run;
+  start(sensor, run, now);
+  while (!poll(sensor, run, now)){
+    now++;
+  }
+  return now;
+}
+
+static Event blocking(const Sensor sensors[], uint8_t n){
+  Event event = {0, 0};
+  uint32_t now = 0;
+  for (uint8_t i=0; i<n; i++){
+    uint32_t on = now;
+    now = run_alone(sensors[i], now + sensors[i].warmup_ms);
+    for (uint8_t bit=0; bit<N_RAILS; bit++){
+      if (sensors[i].rails & (1 << bit)){
+        event.rail_on_ms += now - on;
+      }
+    }
+  }
+  event.awake_ms = now;
+  return event;
+}
+
+static Event scheduled(const Sensor sensors[], uint8_t n){
+  Event event = {0, 0};
+  Running runs[8];
+  uint32_t now = 0;
+  uint8_t users[N_RAILS] = {0, 0, 0};
+  uint32_t on_since[N_RAILS];
+
+  // The scheduled sensors, together
+  uint8_t nscheduled = 0;
+  for (uint8_t i=0; i<n; i++){
+    if (sensors[i].type == UNSCHEDULABLE){
+      continue;
+    }
+    runs[i].state = WARMING_UP;
+    nscheduled++;
+    for (uint8_t bit=0; bit<N_RAILS; bit++){
+      if ((sensors[i].rails & (1 << bit)) && users[bit]++ == 0){
+        on_since[bit] = now;
+      }
+    }
+  }
+  CHECK(nscheduled <= ALOG_MAX_SCHEDULED_SENSORS);
+  bool all_done;
+  do {
+    all_done = true;
+    for (uint8_t i=0; i<n; i++){
+      if (sensors[i].type == UNSCHEDULABLE){
+        continue;
+      }
+      Running &run = runs[i];
+      if (run.state == WARMING_UP && now >= sensors[i].warmup_ms){
+        start(sensors[i], run, now);
+        run.state = RUNNING;
+      }
+      else if (run.state == RUNNING && poll(sensors[i], run, now)){
+        run.state = DONE;
+        for (uint8_t bit=0; bit<N_RAILS; bit++){
+          if ((sensors[i].rails & (1 << bit)) && --users[bit] == 0){
+            event.rail_on_ms += now - on_since[bit];
+          }
+        }
+      }
+      all_done &= (run.state == DONE);
+    }
+    if (!all_done){
+      now++;
+    }
+  } while (!all_done);
+
+  // Then the others, one at a time
+  for (uint8_t i=0; i<n; i++){
+    if (sensors[i].type != UNSCHEDULABLE){
+      continue;
+    }
+    uint32_t on = now;
+    now = run_alone(sensors[i], now + sensors[i].warmup_ms);
+    for (uint8_t bit=0; bit<N_RAILS; bit++){
+      if (sensors[i].rails & (1 << bit)){
+        event.rail_on_ms += now - on;
+      }
+    }
+  }
+  event.awake_ms = now;
+  return event;
+}
+
+static void report(const char *title, const Sensor sensors[], uint8_t n){
+  // Average over 200 logging events (adaptive bursts vary in length)
+  double blocking_awake = 0;
+  double blocking_rails = 0;
+  double scheduled_awake = 0;
+  double scheduled_rails = 0;
+  for (uint16_t trial=0; trial<200; trial++){
+    // The same pings both ways
+    random_state = trial;
+    Event a = blocking(sensors, n);
+    random_state = trial;
+    Event b = scheduled(sensors, n);
+    blocking_awake += a.awake_ms / 200.;
+    blocking_rails += a.rail_on_ms / 200.;
+    scheduled_awake += b.awake_ms / 200.;
+    scheduled_rails += b.rail_on_ms / 200.;
+  }
+  printf("%s\n", title);
+  for (uint8_t i=0; i<n; i++){
+    printf("    %s\n", sensors[i].name);
+  }
+  printf("  awake:    %6.0f ms blocking, %6.0f ms scheduled (%2.0f%% less)\n",
+         blocking_awake, scheduled_awake,
+         100. * (1. - scheduled_awake / blocking_awake));
+  printf("  rails on: %6.0f ms blocking, %6.0f ms scheduled (%2.0f%% less)\n",
+         blocking_rails, scheduled_rails,
+         100. * (1. - scheduled_rails / blocking_rails));
+  // Scheduling never takes longer
+  CHECK(scheduled_awake <= blocking_awake);
+  CHECK(scheduled_rails <= blocking_rails);
+}
+
+int main(){
+  const uint8_t RAIL_3V3 = 0x01;
+  const uint8_t RAIL_5V0 = 0x02;
+
+  const Sensor barometer_and_ranger[] = {
+    {"BMP180 (3V3 rail, 2 ms warm-up)", BMP180, RAIL_3V3, 2, 0, 0, 0},
+    {"HRXL-MaxSonar, 10 pings (5V0 rail, 160 ms warm-up)", ULTRASONIC,
+     RAIL_5V0, 160, 10, 20, 0}};
+  report("BMP180 and an ultrasonic rangefinder:", barometer_and_ranger, 2);
+  // The BMP180 conversion and warm-up run within the warm-up of the ranger
+  random_state = 0;
+  Event b = scheduled(barometer_and_ranger, 2);
+  random_state = 0;
+  CHECK(b.awake_ms == run_alone(barometer_and_ranger[1], 160));
+
+  const Sensor two_rangers[] = {
+    {"BMP180 (3V3 rail, 2 ms warm-up)", BMP180, RAIL_3V3, 2, 0, 0, 0},
+    {"HRXL-MaxSonar, up to 30 pings, adaptive, calm (5V0 rail, 160 ms)",
+     ULTRASONIC, RAIL_5V0, 160, 30, 1, 0},
+    {"1-cm MaxSonar, up to 30 pings, adaptive, rough (5V0 rail, 160 ms)",
+     ULTRASONIC, RAIL_5V0, 160, 30, 6, 0}};
+  report("Two rangefinders facing different surfaces:", two_rangers, 3);
+
+  const Sensor with_others[] = {
+    {"BMP180 (3V3 rail, 2 ms warm-up)", BMP180, RAIL_3V3, 2, 0, 0, 0},
+    {"HRXL-MaxSonar, 10 pings (5V0 rail, 160 ms warm-up)", ULTRASONIC,
+     RAIL_5V0, 160, 10, 20, 0},
+    {"Decagon 5TE, not schedulable (~300 ms)", UNSCHEDULABLE, RAIL_3V3, 0,
+     0, 0, 300},
+    {"SDI-12 sensor, not schedulable (~1 s measurement)", UNSCHEDULABLE,
+     RAIL_5V0, 0, 0, 0, 1100}};
+  report("With sensors that cannot be scheduled:", with_others, 4);
+
+  return _failures;
+}
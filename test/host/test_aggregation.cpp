@@ -0,0 +1,254 @@
+// ALogAggregation and ALogStats, as ALog::set_aggregation() uses them: lines
+// as written to raw.txt (time stamp, numbers, -9999 for no data, and text)
+// go through the window logic as ALog::unixDatestamp(), write_value(), and
+// write_text() send them, and the statistics of each window are checked
+// against a direct, two-pass computation on the same text.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+// Deterministic noise, so that every run tests the same lines
+static uint32_t random_state = 2024;
+
+static float uniform(){
+  random_state = random_state * 1664525UL + 1013904223UL;
+  return ((random_state >> 8) + 0.5f) / 16777216.f;
+}
+
+static float gaussian(float mean, float standard_deviation){
+  return mean + standard_deviation * sqrtf(-2.f * logf(uniform())) * \
+         cosf(6.2831853f * uniform());
+}
+
+#define WINDOW_SECONDS 300
+#define NVALUES 4 // The fifth value in each line is past the end
+#define MAX_LINES 200
+#define LINE_LENGTH 128
+
+static char lines[MAX_LINES][LINE_LENGTH];
+static uint16_t nlines = 0;
+
+static void append_value(char *line, float value, uint8_t decimals){
+  // As write_value(): the text of the number, then a comma
+  char text[FLOAT_TEXT_LENGTH + 1];
+  text[_formatFloat(text, value, decimals)] = '\0';
+  strcat(line, text);
+  strcat(line, ",");
+}
+
+static void make_lines(){
+  // Every 37 s: a temperature around 0 (2 decimals); a pressure (1 decimal)
+  // that is missing a quarter of the time; a status (text); a level (0
+  // decimals) that is missing for all of one window; and one more value.
+  // No lines at all in one window, and only -9999 and text in another.
+  // 12 windows, the first line 11 s after the start of the first
+  uint32_t first = 1500000000UL - 1500000000UL % WINDOW_SECONDS;
+  for (uint32_t t=first + 11; t<first + 12 * WINDOW_SECONDS; t+=37){
+    uint32_t window = (t - first) / WINDOW_SECONDS;
+    if (window == 5){
+      continue;
+    }
+    char *line = lines[nlines++];
+    sprintf(line, "%lu,", (unsigned long)t);
+    bool all_missing = (window == 8);
+    append_value(line, all_missing ? -9999 : gaussian(0, 3), 2);
+    append_value(line, (all_missing || uniform() < 0.25) ? -9999 : \
+                 gaussian(101325, 150), 1);
+    strcat(line, uniform() < 0.9 ? "OK," : "ERR,");
+    append_value(line, (all_missing || window == 3) ? -9999 : \
+                 floorf(100 * uniform()), 0);
+    append_value(line, 42, 0);
+  }
+  CHECK(nlines < MAX_LINES);
+}
+
+static bool is_number(const char *field, double *value, uint8_t *decimals){
+  char *end;
+  *value = strtod(field, &end);
+  if (end == field || (*end != ',' && *end != '\0')){
+    return false;
+  }
+  const char *point = strchr(field, '.');
+  *decimals = (point && point < end) ? end - point - 1 : 0;
+  return true;
+}
+
+static const char *field(const char *line, uint8_t column){
+  // Column 0 is the time stamp
+  for (uint8_t i=0; i<column; i++){
+    line = strchr(line, ',') + 1;
+  }
+  return line;
+}
+
+static uint16_t windows_checked = 0;
+
+static void check_window(ALogAggregation &aggregation){
+  // The statistics of the window that has ended, against the raw lines
+  uint32_t start = aggregation.window_start();
+  CHECK(start % WINDOW_SECONDS == 0);
+  CHECK(aggregation.nvalues() == NVALUES);
+  for (uint8_t i=0; i<NVALUES; i++){
+    double values[MAX_LINES];
+    uint16_t n = 0;
+    uint8_t decimals = 0;
+    bool text = false;
+    for (uint16_t j=0; j<nlines; j++){
+      uint32_t t = strtoul(lines[j], NULL, 10);
+      if (t < start || t >= start + WINDOW_SECONDS){
+        continue;
+      }
+      double value;
+      if (!is_number(field(lines[j], i + 1), &value, &decimals)){
+        text = true;
+      }
+      else if (value != -9999){
+        values[n++] = value;
+      }
+    }
+    ALogStats &stats = aggregation.stats(i);
+    CHECK(stats.count() == n);
+    if (text){
+      CHECK(n == 0);
+    }
+    else {
+      CHECK(aggregation.decimals(i) == decimals);
+    }
+    if (n == 0){
+      continue;
+    }
+    double sum = 0;
+    double minimum = values[0];
+    double maximum = values[0];
+    for (uint16_t j=0; j<n; j++){
+      sum += values[j];
+      minimum = fmin(minimum, values[j]);
+      maximum = fmax(maximum, values[j]);
+    }
+    double mean = sum / n;
+    double squares = 0;
+    for (uint16_t j=0; j<n; j++){
+      squares += (values[j] - mean) * (values[j] - mean);
+    }
+    // Floats hold about 7 significant figures
+    CHECK_NEAR(stats.mean(), mean, 1e-6 * fabs(mean) + 1e-4);
+    CHECK(stats.minimum() == (float)minimum);
+    CHECK(stats.maximum() == (float)maximum);
+    double standard_deviation = sqrt(squares / n);
+    CHECK_NEAR(stats.standard_deviation(), standard_deviation, \
+               1e-3 * standard_deviation + 1e-3);
+  }
+  windows_checked++;
+}
+
+static bool has_readings(uint32_t window){
+  // Whether any line in this window has a number (not -9999) in the first
+  // NVALUES columns: only these windows have statistics written
+  for (uint16_t j=0; j<nlines; j++){
+    if (strtoul(lines[j], NULL, 10) / WINDOW_SECONDS != window){
+      continue;
+    }
+    for (uint8_t i=0; i<NVALUES; i++){
+      double value;
+      uint8_t decimals;
+      if (is_number(field(lines[j], i + 1), &value, &decimals) && \
+          value != -9999){
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void test_windows(){
+  make_lines();
+  ALogAggregation aggregation;
+  CHECK(!aggregation.active());
+  CHECK(aggregation.begin(WINDOW_SECONDS, NVALUES));
+  CHECK(aggregation.active());
+  CHECK(aggregation.window_seconds() == WINDOW_SECONDS);
+
+  uint32_t written[MAX_LINES];
+  uint16_t nwritten = 0;
+  for (uint16_t j=0; j<nlines; j++){
+    // As unixDatestamp(), then write_value() or write_text() for each value
+    uint32_t t = strtoul(lines[j], NULL, 10);
+    if (aggregation.window_ended(t)){
+      written[nwritten++] = aggregation.window_start();
+      check_window(aggregation);
+      aggregation.clear();
+    }
+    aggregation.start_line(t);
+    for (const char *f=field(lines[j], 1); *f; f=strchr(f, ',') + 1){
+      double value;
+      uint8_t decimals;
+      if (is_number(f, &value, &decimals)){
+        aggregation.add(value, decimals);
+      }
+      else {
+        aggregation.skip();
+      }
+    }
+  }
+  // The last window, which ALog writes at the first line of the next one
+  CHECK(aggregation.window_ended(0xFFFFFFFFUL));
+  written[nwritten++] = aggregation.window_start();
+  check_window(aggregation);
+  aggregation.clear();
+  CHECK(!aggregation.window_ended(0xFFFFFFFFUL));
+  for (uint8_t i=0; i<NVALUES; i++){
+    CHECK(aggregation.stats(i).count() == 0);
+  }
+
+  // One line of statistics for each window with readings, and none for the
+  // window with no lines or the one with only -9999 and text
+  uint32_t first = strtoul(lines[0], NULL, 10) / WINDOW_SECONDS;
+  uint32_t last = strtoul(lines[nlines - 1], NULL, 10) / WINDOW_SECONDS;
+  uint16_t k = 0;
+  for (uint32_t window=first; window<=last; window++){
+    if (has_readings(window)){
+      CHECK(k < nwritten && written[k] == window * WINDOW_SECONDS);
+      k++;
+    }
+  }
+  CHECK(k == nwritten);
+  CHECK(nwritten == 10);
+  printf("test_aggregation: %u lines, %u windows of statistics\n",
+         nlines, windows_checked);
+
+  aggregation.end();
+  CHECK(!aggregation.active());
+}
+
+static void test_single_reading(){
+  // One reading: its own mean, minimum, and maximum, with no spread
+  ALogAggregation aggregation;
+  CHECK(aggregation.begin(60, 2));
+  CHECK(!aggregation.window_ended(120));
+  aggregation.start_line(120);
+  aggregation.add(-3.25, 2);
+  aggregation.add(-9999, 0);
+  CHECK(!aggregation.window_ended(179));
+  CHECK(aggregation.window_ended(180));
+  CHECK(aggregation.window_start() == 120);
+  CHECK(aggregation.stats(0).count() == 1);
+  CHECK(aggregation.stats(0).mean() == -3.25f);
+  CHECK(aggregation.stats(0).minimum() == -3.25f);
+  CHECK(aggregation.stats(0).maximum() == -3.25f);
+  CHECK(aggregation.stats(0).standard_deviation() == 0);
+  CHECK(aggregation.stats(1).count() == 0);
+
+  // A window of 0 s is taken as 1 s
+  CHECK(aggregation.begin(0, 1));
+  CHECK(aggregation.window_seconds() == 1);
+}
+
+int main(){
+  test_windows();
+  test_single_reading();
+  return _failures;
+}
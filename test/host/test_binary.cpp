@@ -0,0 +1,250 @@
+// ALogBinaryEncoder, round trip: lines are encoded as ALog::write_value() and
+// write_binary_line() encode them into data.bin, decoded with
+// doc/decodeBinary.py, and compared with the text that the data file would
+// have had. Covers negative differences, -9999, new blocks (full, a change in
+// the number of values or decimal places, time going backwards), a damaged
+// line that the decoder must skip to the next block, and a last line cut
+// short. Needs python3.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+#define BIN_FILE "test_binary_data.bin"
+#define TEXT_FILE "test_binary_data.txt"
+#define ERROR_FILE "test_binary_data.err"
+#define DECODE "python3 ../../doc/decodeBinary.py " BIN_FILE " " TEXT_FILE \
+               " 2> " ERROR_FILE
+
+// Deterministic noise, so that every run tests the same lines
+static uint32_t random_state = 777;
+
+static float uniform(){
+  random_state = random_state * 1664525UL + 1013904223UL;
+  return ((random_state >> 8) + 0.5f) / 16777216.f;
+}
+
+#define MAX_LINES 200
+
+// The encoded stream, where each line starts in it, and the text expected
+// for each line
+static uint8_t data[MAX_LINES * ALOG_BINARY_LINE_BYTES];
+static size_t length = 0;
+static size_t line_start[MAX_LINES];
+static char expected[MAX_LINES][128];
+static uint16_t nlines = 0;
+
+static ALogBinaryEncoder *encoder;
+
+static void reset(){
+  delete encoder;
+  encoder = new ALogBinaryEncoder; // As after a reboot
+  length = 0;
+  nlines = 0;
+}
+
+static void encode(uint32_t unixtime, const float values[], \
+                   const uint8_t decimals[], uint8_t n){
+  // As unixDatestamp(), write_value() for each value, and endLine(); the
+  // expected text is as the data file has it, less the trailing comma
+  char *text = expected[nlines];
+  sprintf(text, "%lu", (unsigned long)unixtime);
+  encoder->start_line(unixtime);
+  for (uint8_t i=0; i<n; i++){
+    encoder->add(values[i], decimals[i]);
+    char number[FLOAT_TEXT_LENGTH + 1];
+    number[_formatFloat(number, values[i], decimals[i])] = '\0';
+    strcat(text, ",");
+    strcat(text, number);
+  }
+  line_start[nlines++] = length;
+  uint8_t bytes = encoder->end_line(data + length);
+  CHECK(bytes <= ALOG_BINARY_LINE_BYTES);
+  length += bytes;
+}
+
+static bool decode(char *errors, size_t errors_length){
+  // Writes data to a file and decodes it into TEXT_FILE; errors gets what
+  // the decoder reported
+  FILE *f = fopen(BIN_FILE, "wb");
+  fwrite(data, 1, length, f);
+  fclose(f);
+  if (system(DECODE) != 0){
+    printf("test_binary: could not run: %s\n", DECODE);
+    return false;
+  }
+  f = fopen(ERROR_FILE, "r");
+  size_t n = fread(errors, 1, errors_length - 1, f);
+  errors[n] = '\0';
+  fclose(f);
+  return true;
+}
+
+static void check_text(uint16_t first_skipped, uint16_t end_skipped, \
+                       uint16_t end){
+  // The decoded text, line by line, against the first end expected lines,
+  // less those that are skipped (first_skipped up to end_skipped)
+  FILE *f = fopen(TEXT_FILE, "r");
+  char line[256];
+  uint16_t compared = 0;
+  for (uint16_t j=0; j<end; j++){
+    if (j >= first_skipped && j < end_skipped){
+      continue;
+    }
+    if (!fgets(line, sizeof(line), f)){
+      CHECK(false);
+      break;
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if (strcmp(line, expected[j]) != 0){
+      printf("test_binary: line %u: decoded %s, expected %s\n", j, line,
+             expected[j]);
+      CHECK(false);
+    }
+    compared++;
+  }
+  // No more lines than that
+  CHECK(!fgets(line, sizeof(line), f));
+  fclose(f);
+  CHECK(compared == end - (end_skipped - first_skipped));
+}
+
+static void test_round_trip(){
+  reset();
+  uint32_t t = 1500000000UL;
+  // A temperature that crosses 0 (2 decimals), a pressure (1 decimal), a
+  // count (0 decimals) with large jumps, and a sensor that drops out
+  // (-9999) now and then
+  float values[4] = {0.5, 1013.2, 100, 12.345};
+  const uint8_t decimals[4] = {2, 1, 0, 3};
+  uint16_t block_starts = 0;
+  for (uint16_t j=0; j<80; j++){
+    values[0] = roundf(values[0] * 100 + (uniform() - 0.55) * 40) / 100;
+    values[1] = roundf(values[1] * 10 + (uniform() - 0.5) * 30) / 10;
+    values[2] = (uniform() < 0.2) ? floorf(uniform() * 1e6) : values[2] - 3;
+    float dropout = (uniform() < 0.15) ? -9999 : \
+                    roundf(values[3] * 1000 - 7) / 1000;
+    float line[4] = {values[0], values[1], values[2], dropout};
+    // The number of values changes from line 50 to 59, and, at line 65, the
+    // decimal places of the second value
+    uint8_t n = (j >= 50 && j < 60) ? 3 : 4;
+    uint8_t line_decimals[4];
+    memcpy(line_decimals, decimals, 4);
+    if (j >= 65){
+      line_decimals[1] = 2;
+    }
+    // Time goes back by a minute at line 70 (the clock is set)
+    t += (j == 70) ? -60 : 15 + (uniform() < 0.1) * 600;
+    size_t before = length;
+    encode(t, line, line_decimals, n);
+    block_starts += (data[before] == 1);
+  }
+  // Blocks at 0, 32 (full), 50 and 60 (number of values), 65 (decimal
+  // places), and 70 (time)
+  CHECK(block_starts == 6);
+  printf("test_binary: %u lines, %u blocks, %lu bytes (%.1f per line)\n",
+         nlines, block_starts, (unsigned long)length, (double)length / nlines);
+
+  char errors[1024];
+  if (!decode(errors, sizeof(errors))){
+    CHECK(false);
+    return;
+  }
+  CHECK(errors[0] == '\0');
+  check_text(0, 0, nlines);
+}
+
+static void test_damaged(){
+  // Lines whose bytes contain no 1 (the block start), so that the decoder
+  // resumes at the next block, and not in the middle of this one: every
+  // 60 s, values up by 2 (zigzag 4) or down by 3 (zigzag 5)
+  reset();
+  uint32_t t = 1600000000UL;
+  float values[2] = {20.00, -5.0};
+  const uint8_t decimals[2] = {2, 1};
+  for (uint16_t j=0; j<2 * ALOG_BINARY_BLOCK_LINES + 5; j++){
+    encode(t, values, decimals, 2);
+    t += 60;
+    values[0] += 0.02;
+    values[1] -= 0.3;
+  }
+  uint16_t damaged = 10;
+  uint16_t next_block = ALOG_BINARY_BLOCK_LINES;
+  for (size_t i=line_start[damaged] + 1; i<line_start[next_block]; i++){
+    CHECK(data[i] != 1);
+  }
+  CHECK(data[line_start[next_block]] == 1);
+  // A line start that is neither a line (even) nor a block start (1)
+  data[line_start[damaged]] = 3;
+
+  char errors[1024];
+  if (!decode(errors, sizeof(errors))){
+    CHECK(false);
+    return;
+  }
+  CHECK(strstr(errors, "Damaged data") != NULL);
+  // The rest of the damaged block is lost; the blocks after it are whole
+  check_text(damaged, next_block, nlines);
+
+  // Cut short in the last line: all but that line, and a warning
+  data[line_start[damaged]] = 120;
+  length -= 1;
+  if (!decode(errors, sizeof(errors))){
+    CHECK(false);
+    return;
+  }
+  CHECK(strstr(errors, "Incomplete last line") != NULL);
+  CHECK(strstr(errors, "Damaged data") == NULL);
+  check_text(0, 0, nlines - 1);
+}
+
+static void test_extremes(){
+  // Varints and zigzag at their limits; more values than are stored
+  uint8_t bytes[5];
+  CHECK(_writeVarint(bytes, 0) == 1 && bytes[0] == 0);
+  CHECK(_writeVarint(bytes, 127) == 1 && bytes[0] == 127);
+  CHECK(_writeVarint(bytes, 128) == 2 && bytes[0] == 0x80 && bytes[1] == 1);
+  CHECK(_writeVarint(bytes, 0xFFFFFFFFUL) == 5 && bytes[4] == 0x0F);
+  CHECK(_zigzag(0) == 0 && _zigzag(-1) == 1 && _zigzag(1) == 2);
+  CHECK(_zigzag(2147483647L) == 0xFFFFFFFEUL);
+  CHECK(_zigzag(-2147483647L - 1) == 0xFFFFFFFFUL);
+
+  reset();
+  float values[ALOG_BINARY_MAX_VALUES + 2];
+  uint8_t decimals[ALOG_BINARY_MAX_VALUES + 2];
+  for (uint8_t i=0; i<ALOG_BINARY_MAX_VALUES + 2; i++){
+    values[i] = (i % 2) ? -3e6 : 3e6;
+    decimals[i] = 3; // Beyond +/-2e9 once scaled: held at the limits
+  }
+  encoder->start_line(1700000000UL);
+  for (uint8_t i=0; i<ALOG_BINARY_MAX_VALUES + 2; i++){
+    encoder->add(values[i], decimals[i]);
+  }
+  length = encoder->end_line(data);
+  CHECK(length <= ALOG_BINARY_LINE_BYTES);
+  CHECK(data[1] == ALOG_BINARY_MAX_VALUES);
+  char errors[1024];
+  if (!decode(errors, sizeof(errors))){
+    CHECK(false);
+    return;
+  }
+  FILE *f = fopen(TEXT_FILE, "r");
+  char line[512];
+  CHECK(fgets(line, sizeof(line), f) != NULL);
+  fclose(f);
+  CHECK(strncmp(line, "1700000000,2000000.000,-2000000.000,", 36) == 0);
+}
+
+int main(){
+  test_round_trip();
+  test_damaged();
+  test_extremes();
+  delete encoder;
+  remove(BIN_FILE);
+  remove(TEXT_FILE);
+  remove(ERROR_FILE);
+  return _failures;
+}
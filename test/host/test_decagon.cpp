@@ -0,0 +1,153 @@
+// ALogDDIFrame, which reads the Decagon DDI serial frames of the 5TE in
+// ALog::Decagon5TE(): good frames, bad checksums, frames cut short, and
+// noise on the line before and within a frame.
+
+#include <string.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+static char checksum(const char *frame){
+  // Computed here independently: the sum of the characters from the <TAB>
+  // through the sensor type, modulo 64, plus 32
+  unsigned int sum = 0;
+  for (const char *c=strchr(frame, '\t'); *c; c++){
+    sum += (unsigned char)*c;
+  }
+  return sum % 64 + 32;
+}
+
+static void make_frame(char *out, const char *values, char sensor_type, \
+                       int checksum_error){
+  // <TAB>values<CR><sensor type><checksum><CR><LF>
+  sprintf(out, "\t%s\r%c", values, sensor_type);
+  size_t length = strlen(out);
+  out[length] = checksum(out) + checksum_error;
+  strcpy(out + length + 1, "\r\n");
+}
+
+static int feed(ALogDDIFrame &frame, const char *text, size_t length){
+  // Characters added up to and including the one that ended the frame, or
+  // -1 if it did not end
+  for (size_t i=0; i<length; i++){
+    if (frame.add(text[i])){
+      return i + 1;
+    }
+  }
+  return -1;
+}
+
+static int feed(ALogDDIFrame &frame, const char *text){
+  return feed(frame, text, strlen(text));
+}
+
+static void test_good(){
+  char text[64];
+  make_frame(text, "1234 567 890", 'z', 0);
+  ALogDDIFrame frame;
+  // Ends at the checksum, before the <CR><LF>
+  CHECK(feed(frame, text) == (int)strlen(text) - 2);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 1234);
+  CHECK(frame.value(1) == 567);
+  CHECK(frame.value(2) == 890);
+  CHECK(frame.value(3) == 0);
+
+  // Error codes and values of 0 come through as they are
+  make_frame(text, "4095 0 1023", 'z', 0);
+  frame.reset();
+  CHECK(feed(frame, text) > 0);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 4095 && frame.value(1) == 0 && \
+        frame.value(2) == 1023);
+
+  // Extra spaces between values
+  make_frame(text, "12  34 56 ", 'x', 0);
+  frame.reset();
+  CHECK(feed(frame, text) > 0);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 12 && frame.value(1) == 34 && frame.value(2) == 56);
+}
+
+static void test_bad_checksum(){
+  char text[64];
+  for (int error=-2; error<=2; error++){
+    if (error == 0){
+      continue;
+    }
+    make_frame(text, "1234 567 890", 'z', error);
+    ALogDDIFrame frame;
+    CHECK(feed(frame, text) == (int)strlen(text) - 2);
+    CHECK(!frame.good());
+  }
+  // A sensor type that differs from the one the checksum was taken over
+  make_frame(text, "1234 567 890", 'z', 0);
+  text[strlen(text) - 4] = 'y';
+  ALogDDIFrame frame;
+  CHECK(feed(frame, text) > 0);
+  CHECK(!frame.good());
+}
+
+static void test_wrong_number_of_values(){
+  char text[64];
+  ALogDDIFrame frame;
+  make_frame(text, "1234 567", 'z', 0);
+  CHECK(feed(frame, text) > 0);
+  CHECK(!frame.good());
+  make_frame(text, "1234 567 890 12", 'z', 0);
+  frame.reset();
+  CHECK(feed(frame, text) > 0);
+  CHECK(!frame.good());
+}
+
+static void test_truncated(){
+  // Cut off anywhere before the checksum: never ends (Decagon5TE() times
+  // out), and is never good
+  char text[64];
+  make_frame(text, "1234 567 890", 'z', 0);
+  size_t checksum_position = strlen(text) - 3;
+  for (size_t length=0; length<=checksum_position; length++){
+    ALogDDIFrame frame;
+    CHECK(feed(frame, text, length) == -1);
+    CHECK(!frame.good());
+  }
+}
+
+static void test_noise(){
+  char good[64];
+  make_frame(good, "1234 567 890", 'z', 0);
+  char text[128];
+
+  // Noise, including digits, spaces, and line ends, before the <TAB>
+  sprintf(text, "99 x\r\n\x01\xff 12%s", good);
+  ALogDDIFrame frame;
+  CHECK(feed(frame, text) == (int)strlen(text) - 2);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 1234 && frame.value(2) == 890);
+
+  // A frame garbled within its values is dropped, and the next one read
+  sprintf(text, "\t12#4 5%s", good);
+  frame.reset();
+  CHECK(feed(frame, text) == (int)strlen(text) - 2);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 1234 && frame.value(1) == 567);
+
+  // A frame cut short by the start of the next one
+  sprintf(text, "\t12 3%s", good);
+  frame.reset();
+  CHECK(feed(frame, text) > 0);
+  CHECK(frame.good());
+  CHECK(frame.value(0) == 1234);
+}
+
+int main(){
+  test_good();
+  test_bad_checksum();
+  test_wrong_number_of_values();
+  test_truncated();
+  test_noise();
+  if (_failures == 0){
+    printf("test_decagon: all DDI frame tests passed\n");
+  }
+  return _failures;
+}
@@ -0,0 +1,148 @@
+// _formatFloat() must write exactly what Print::printFloat() writes on AVR,
+// where double is float. print_float_avr() below is printFloat() with every
+// double made a float; each value is written both ways and compared.
+//
+// ./test_format            every 4099th float bit pattern, 0-8 decimals
+// ./test_format all        every float bit pattern (~2 hours)
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+static uint8_t print_float_avr(char *text, float number, uint8_t digits){
+  // As Print::printFloat(), in float
+  char *p = text;
+  if (isnan(number)){
+    return sprintf(text, "nan");
+  }
+  if (isinf(number)){
+    return sprintf(text, "inf");
+  }
+  if (number > 4294967040.0f || number < -4294967040.0f){
+    return sprintf(text, "ovf");
+  }
+  if (number < 0.0f){
+    *p++ = '-';
+    number = -number;
+  }
+  float rounding = 0.5f;
+  for (uint8_t i=0; i<digits; i++){
+    rounding /= 10.0f;
+  }
+  number += rounding;
+  uint32_t int_part = (uint32_t)number;
+  float remainder = number - (float)int_part;
+  p += sprintf(p, "%lu", (unsigned long)int_part);
+  if (digits > 0){
+    *p++ = '.';
+  }
+  while (digits-- > 0){
+    remainder *= 10.0f;
+    unsigned int to_print = (unsigned int)remainder;
+    p += sprintf(p, "%u", to_print);
+    remainder -= to_print;
+  }
+  *p = '\0';
+  return p - text;
+}
+
+static bool same_text(float value, uint8_t decimals){
+  char expected[64];
+  char text[FLOAT_TEXT_LENGTH + 1];
+  uint8_t expected_length = print_float_avr(expected, value, decimals);
+  uint8_t length = _formatFloat(text, value, decimals);
+  text[length] = '\0';
+  if (length != expected_length || strcmp(text, expected) != 0){
+    printf("%.9g, %u decimals: \"%s\", not \"%s\"\n", value, decimals, text,
+           expected);
+    return false;
+  }
+  return true;
+}
+
+static bool text_is(float value, uint8_t decimals, const char *expected){
+  char text[FLOAT_TEXT_LENGTH + 1];
+  text[_formatFloat(text, value, decimals)] = '\0';
+  if (strcmp(text, expected) != 0){
+    printf("%.9g, %u decimals: \"%s\", not \"%s\"\n", value, decimals, text,
+           expected);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv){
+  // Special values, and the no-data value
+  CHECK(text_is(NAN, 2, "nan"));
+  CHECK(text_is(INFINITY, 2, "inf"));
+  CHECK(text_is(-INFINITY, 2, "inf"));
+  CHECK(text_is(4294967040.0f, 0, "4294967040"));
+  CHECK(text_is(4294967296.0f, 2, "ovf"));
+  CHECK(text_is(-4294967296.0f, 2, "ovf"));
+  CHECK(text_is(-0.0f, 2, "0.00"));
+  CHECK(text_is(-9999, 0, "-9999"));
+  CHECK(text_is(-9999, 2, "-9999.00"));
+  CHECK(text_is(-9999, 4, "-9999.0000"));
+  CHECK(text_is(0.126f, 2, "0.13"));
+  // printFloat() adds a float 0.005, just under 0.005, so this rounds down
+  CHECK(text_is(0.125f, 2, "0.12"));
+  CHECK(text_is(2.5f, 0, "3"));
+  // More decimal places than FLOAT_TEXT_MAX_DECIMALS are cut to it
+  CHECK(text_is(1.0f, 12, "1.00000000"));
+
+  const float special[] = {NAN, INFINITY, -INFINITY, 4294967040.0f,
+                           -4294967040.0f, 4294967296.0f, -0.0f, 0.0f,
+                           -9999.0f, 1e-45f, 0.5f, 0.05f, 0.005f, 9.995f,
+                           99.995f, 1.0f/3.0f, 2.0f/3.0f, 123456.789f};
+  for (uint8_t i=0; i<sizeof(special)/sizeof(special[0]); i++){
+    for (uint8_t decimals=0; decimals<=FLOAT_TEXT_MAX_DECIMALS; decimals++){
+      CHECK(same_text(special[i], decimals));
+    }
+  }
+
+  // Sweep the float bit patterns: all, or a stride that reaches every
+  // exponent and sign with a spread of mantissas
+  uint64_t stride = (argc > 1 && strcmp(argv[1], "all") == 0) ? 1 : 4099;
+  uint32_t ncompared = 0;
+  uint32_t ndifferent = 0;
+  for (uint64_t bits=0; bits<=0xFFFFFFFFULL; bits+=stride){
+    uint32_t pattern = (uint32_t)bits;
+    float value;
+    memcpy(&value, &pattern, sizeof(value));
+    for (uint8_t decimals=0; decimals<=FLOAT_TEXT_MAX_DECIMALS; decimals++){
+      if (!same_text(value, decimals) && ++ndifferent >= 20){
+        printf("Stopping after 20 differences\n");
+        return 1;
+      }
+      ncompared++;
+    }
+  }
+  CHECK(ndifferent == 0);
+  printf("test_format: %lu values compared with printFloat()\n",
+         (unsigned long)ncompared);
+
+  // Speed, for the record: typical logged values with 2 decimal places
+  const uint32_t nbenchmark = 2000000;
+  char text[64];
+  volatile uint32_t sink = 0;
+  clock_t start = clock();
+  for (uint32_t i=0; i<nbenchmark; i++){
+    sink += print_float_avr(text, i * 0.0137f - 5000.f, 2);
+  }
+  double seconds_print_float = (double)(clock() - start) / CLOCKS_PER_SEC;
+  start = clock();
+  for (uint32_t i=0; i<nbenchmark; i++){
+    sink += _formatFloat(text, i * 0.0137f - 5000.f, 2);
+  }
+  double seconds_format_float = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("test_format: printFloat() %.0f ns, _formatFloat() %.0f ns per "
+         "value (%.1fx)\n", seconds_print_float / nbenchmark * 1e9,
+         seconds_format_float / nbenchmark * 1e9,
+         seconds_print_float / seconds_format_float);
+
+  return _failures;
+}
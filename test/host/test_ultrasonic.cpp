@@ -0,0 +1,246 @@
+// ALogStats and the ultrasonic burst estimators, on synthetic bursts of
+// pings: a calm surface (Gaussian noise), and one with snowfall or
+// vegetation (some pings return short of the surface). Also counts how many
+// pings the adaptive stop (set_ultrasonic_adaptive()) saves.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ALogCore.h"
+#include "check.h"
+
+// Deterministic noise, so that every run tests the same bursts
+static uint32_t random_state = 12345;
+
+static float uniform(){
+  random_state = random_state * 1664525UL + 1013904223UL;
+  return ((random_state >> 8) + 0.5f) / 16777216.f;
+}
+
+static float gaussian(float mean, float standard_deviation){
+  // Box-Muller
+  return mean + standard_deviation * sqrtf(-2.f * logf(uniform())) * \
+         cosf(6.2831853f * uniform());
+}
+
+static float ping(float range, float noise, float outlier_fraction){
+  // A range, or (outlier_fraction of the time) an echo from something
+  // between the sensor and the surface
+  if (uniform() < outlier_fraction){
+    return range * uniform();
+  }
+  return gaussian(range, noise);
+}
+
+struct Burst {
+  ALogStats stats;
+  float recent_ranges[ULTRASONIC_ROBUST_BUFFER_SIZE];
+};
+
+static void add(Burst &burst, float range){
+  _ultrasonicAddPing(range, burst.recent_ranges, burst.stats);
+}
+
+static float estimate(Burst burst, uint8_t estimator){
+  // On a copy, as the estimators sort recent_ranges
+  return _ultrasonicEstimate(estimator, burst.recent_ranges, burst.stats);
+}
+
+static void test_statistics(){
+  // Against a direct, two-pass computation
+  float values[200];
+  ALogStats stats;
+  for (uint8_t i=0; i<200; i++){
+    values[i] = gaussian(1000.f, 25.f);
+    stats.add(values[i]);
+  }
+  double sum = 0;
+  double minimum = values[0];
+  double maximum = values[0];
+  for (uint8_t i=0; i<200; i++){
+    sum += values[i];
+    minimum = fmin(minimum, values[i]);
+    maximum = fmax(maximum, values[i]);
+  }
+  double mean = sum / 200;
+  double squares = 0;
+  for (uint8_t i=0; i<200; i++){
+    squares += (values[i] - mean) * (values[i] - mean);
+  }
+  CHECK(stats.count() == 200);
+  CHECK_NEAR(stats.mean(), mean, 1e-3);
+  CHECK_NEAR(stats.variance(), squares / 200, 0.05);
+  CHECK_NEAR(stats.standard_deviation(), sqrt(squares / 200), 1e-3);
+  CHECK(stats.minimum() == minimum);
+  CHECK(stats.maximum() == maximum);
+  // The streaming median of a symmetric distribution is near its center
+  CHECK_NEAR(stats.median_estimate(), 1000., 5.);
+
+  stats.reset();
+  CHECK(stats.count() == 0);
+  CHECK(stats.mean() == 0);
+  CHECK(stats.variance() == 0);
+  stats.add(-3.5f);
+  CHECK(stats.minimum() == -3.5f && stats.maximum() == -3.5f);
+  CHECK(stats.median_estimate() == -3.5f);
+}
+
+static void test_estimators_exact(){
+  // 11 pings: 8 on the surface and 3 far-off echoes, so the results are
+  // known exactly
+  const float pings[] = {1502, 1498, 300, 1500, 1501, 1499, 250, 1500,
+                         1503, 1497, 900};
+  Burst burst;
+  double sum = 0;
+  for (uint8_t i=0; i<11; i++){
+    add(burst, pings[i]);
+    sum += pings[i];
+  }
+  CHECK_NEAR(estimate(burst, ULTRASONIC_MEAN), sum / 11, 1e-3);
+  CHECK(estimate(burst, ULTRASONIC_MEDIAN) == 1499);
+  // Drop the lowest and highest 2 (11/4): 1497 ... 1502
+  CHECK_NEAR(estimate(burst, ULTRASONIC_TRIMMED_MEAN), \
+             (900 + 1497 + 1498 + 1499 + 1500 + 1500 + 1501) / 7., 1e-3);
+  // MAD is 2, so the 3 echoes are rejected and the 8 pings kept
+  CHECK_NEAR(estimate(burst, ULTRASONIC_MAD_FILTERED_MEAN), \
+             (1502 + 1498 + 1500 + 1501 + 1499 + 1500 + 1503 + 1497) / 8., \
+             1e-3);
+
+  // An even number of pings: the median is the mean of the middle two
+  Burst even;
+  add(even, 10);
+  add(even, 40);
+  add(even, 20);
+  add(even, 30);
+  CHECK(estimate(even, ULTRASONIC_MEDIAN) == 25);
+
+  // No pings at all
+  Burst empty;
+  CHECK(estimate(empty, ULTRASONIC_MEDIAN) == 0);
+
+  // _sortSmallArray()
+  float values[] = {3, -1, 2, 2, 0};
+  _sortSmallArray(values, 5);
+  CHECK(values[0] == -1 && values[1] == 0 && values[2] == 2 && \
+        values[3] == 2 && values[4] == 3);
+}
+
+static double rms_error(uint8_t estimator, uint8_t npings, float noise, \
+                        float outlier_fraction){
+  // Root-mean-square error of an estimator over 2000 bursts
+  const float range = 1500;
+  double squares = 0;
+  for (uint16_t trial=0; trial<2000; trial++){
+    Burst burst;
+    for (uint8_t i=0; i<npings; i++){
+      add(burst, ping(range, noise, outlier_fraction));
+    }
+    double error = estimate(burst, estimator) - range;
+    squares += error * error;
+  }
+  return sqrt(squares / 2000);
+}
+
+static void test_estimators_noisy(){
+  const char *names[] = {"mean", "median", "trimmed mean", \
+                         "MAD-filtered mean"};
+  printf("test_ultrasonic: RMS error [mm] of 15 pings, 3 mm noise:\n");
+  printf("  %-18s %8s %14s\n", "", "calm", "10% outliers");
+  double calm[4];
+  double outliers[4];
+  for (uint8_t estimator=0; estimator<4; estimator++){
+    calm[estimator] = rms_error(estimator, 15, 3, 0);
+    outliers[estimator] = rms_error(estimator, 15, 3, 0.1);
+    printf("  %-18s %8.2f %14.2f\n", names[estimator], calm[estimator],
+           outliers[estimator]);
+  }
+  // All are good on a calm surface. With outliers, the median and the
+  // MAD-filtered mean stay within a few mm while the mean is off by a long
+  // way. The trimmed mean is only that good while no more than a quarter
+  // of the pings (3 of 15) are outliers
+  for (uint8_t estimator=0; estimator<4; estimator++){
+    CHECK(calm[estimator] < 2);
+  }
+  CHECK(outliers[ULTRASONIC_MEAN] > 50);
+  CHECK(outliers[ULTRASONIC_MEDIAN] < 3);
+  CHECK(outliers[ULTRASONIC_TRIMMED_MEAN] < outliers[ULTRASONIC_MEAN] / 5);
+  CHECK(outliers[ULTRASONIC_MAD_FILTERED_MEAN] < 3);
+
+  // A burst longer than the buffer: the median is the streaming estimate,
+  // seeded with the exact median of the first 15 pings, and it does better
+  // than the exact median of just the last 15
+  double long_median = rms_error(ULTRASONIC_MEDIAN, 60, 3, 0.1);
+  printf("  median of 60 pings, 10%% outliers: %.2f\n", long_median);
+  CHECK(long_median < outliers[ULTRASONIC_MEDIAN]);
+  double long_median_calm = rms_error(ULTRASONIC_MEDIAN, 60, 3, 0);
+  printf("  median of 60 pings, calm: %.2f\n", long_median_calm);
+  CHECK(long_median_calm < calm[ULTRASONIC_MEDIAN]);
+}
+
+static uint8_t adaptive_burst(uint8_t nmax, float noise, \
+                              float outlier_fraction, float *result){
+  // As ultrasonic_burst_poll(), with set_ultrasonic_adaptive(1, 3): stop at
+  // nmax pings, or once the standard error is below 1 mm
+  Burst burst;
+  do {
+    add(burst, ping(1500, noise, outlier_fraction));
+  } while (burst.stats.count() < nmax && \
+           !_ultrasonicConverged(burst.stats, 1., 1., 3));
+  *result = estimate(burst, ULTRASONIC_MEAN);
+  return burst.stats.count();
+}
+
+static void test_convergence(){
+  // Off unless a target is set, and never before the minimum number of
+  // pings
+  Burst burst;
+  add(burst, 1500);
+  add(burst, 1500);
+  add(burst, 1500);
+  CHECK(!_ultrasonicConverged(burst.stats, 1., 0, 3));
+  CHECK(_ultrasonicConverged(burst.stats, 1., 1., 3));
+  CHECK(!_ultrasonicConverged(burst.stats, 1., 1., 4));
+  // Units: 0.1 mm of spread in cm is 1 mm
+  Burst spread;
+  add(spread, 100);
+  add(spread, 100.2);
+  add(spread, 99.8);
+  CHECK(_ultrasonicConverged(spread.stats, 1., 1., 3));
+  CHECK(!_ultrasonicConverged(spread.stats, 10., 1., 3));
+
+  const uint8_t nmax = 30;
+  const float noises[] = {0.5, 1, 2, 4, 8};
+  printf("test_ultrasonic: adaptive bursts of up to %u pings, target 1 mm:"
+         "\n", nmax);
+  printf("  %-10s %12s %12s %16s\n", "noise [mm]", "mean pings", "saved",
+         "RMS error [mm]");
+  for (uint8_t i=0; i<5; i++){
+    uint32_t total = 0;
+    double squares = 0;
+    for (uint16_t trial=0; trial<2000; trial++){
+      float result;
+      total += adaptive_burst(nmax, noises[i], 0, &result);
+      squares += (result - 1500.) * (result - 1500.);
+    }
+    double mean_pings = total / 2000.;
+    printf("  %-10.1f %12.1f %11.0f%% %16.2f\n", noises[i], mean_pings,
+           100. * (1. - mean_pings / nmax), sqrt(squares / 2000));
+    if (noises[i] <= 1){
+      // Calm: stops at (or near) the minimum, 3
+      CHECK(mean_pings < 6);
+    }
+    if (noises[i] >= 8){
+      // Rough: (almost) the full burst
+      CHECK(mean_pings > 0.9 * nmax);
+    }
+  }
+}
+
+int main(){
+  test_statistics();
+  test_estimators_exact();
+  test_estimators_noisy();
+  test_convergence();
+  return _failures;
+}